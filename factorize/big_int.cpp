@@ -1,32 +1,141 @@
+
+
 #include "big_int.h"
+#include "montgomery.h"
 
 #include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <cmath>
 
+// Largest power of ten fitting into a single limb, used for decimal conversion
+constexpr Limb decimalChunk = 10000000000000000000ULL;
+constexpr int decimalChunkDigits = 19;
+
+// Below this many limbs schoolbook multiplication is faster than karatsuba
+constexpr size_t karatsubaThreshold = 32;
+
+
+inline void trimLimbs(std::vector<Limb> &limbs) {
+    limbs.resize(trimmedLength(limbs.data(), limbs.size()));
+}
+
+inline int compareLimbs(const std::vector<Limb> &lhs, const std::vector<Limb> &rhs) {
+    return compareLimbs(lhs.data(), lhs.size(), rhs.data(), rhs.size());
+}
+
+/**
+ * lhs += rhs << (64 * offset)
+ */
+void addLimbs(std::vector<Limb> &lhs, const std::vector<Limb> &rhs, const size_t offset = 0) {
+    if(lhs.size() < rhs.size() + offset) {
+        lhs.resize(rhs.size() + offset, 0);
+    }
+
+    Limb *shifted = lhs.data() + offset;
+    const Limb carry = addLimbs(shifted, shifted, lhs.size() - offset, rhs.data(), rhs.size());
+    if(carry != 0) {
+        lhs.push_back(carry);
+    }
+}
+
+/**
+ * lhs -= rhs. Assumes lhs >= rhs.
+ */
+void subtractLimbs(std::vector<Limb> &lhs, const std::vector<Limb> &rhs) {
+    assert(compareLimbs(lhs, rhs) >= 0);
+    subtractLimbs(lhs.data(), lhs.data(), lhs.size(), rhs.data(), rhs.size());
+    trimLimbs(lhs);
+}
+
+/**
+ * limbs = limbs * factor + summand
+ */
+void multiplyAddLimb(std::vector<Limb> &limbs, const Limb factor, const Limb summand) {
+    const Limb carry = multiplyAddLimb(limbs.data(), limbs.size(), factor, summand);
+    if(carry != 0) {
+        limbs.push_back(carry);
+    }
+    trimLimbs(limbs);
+}
+
+/**
+ * limbs /= divisor
+ * @return The remainder of the division
+ */
+Limb divideLimb(std::vector<Limb> &limbs, const Limb divisor) {
+    const Limb remainder = divideLimb(limbs.data(), limbs.data(), limbs.size(), divisor);
+    trimLimbs(limbs);
+    return remainder;
+}
+
+std::vector<Limb> schoolbookMultiply(const std::vector<Limb> &lhs, const std::vector<Limb> &rhs) {
+    if(lhs.empty() || rhs.empty()) return {};
+
+    std::vector<Limb> result(lhs.size() + rhs.size());
+    multiplyLimbs(result.data(), lhs.data(), lhs.size(), rhs.data(), rhs.size());
+    trimLimbs(result);
+    return result;
+}
+
 
 BigInt::BigInt() = default;
 
 BigInt::BigInt(std::string number) {
 
+    bool sign = true;
     if(!number.empty() && number[0] == '-') {
-        positive = false;
+        sign = false;
         number.erase(0, 1);
     }
 
-    // Remove leading zeroes
-    number.erase(0, number.find_first_not_of('0'));
-    if(number.empty()) {
-        number = "0";
+    // Consume the digits in chunks, so that only one multiplication per limb is needed
+    size_t begin = 0;
+    const size_t firstChunk = number.size() % decimalChunkDigits;
+    size_t end = firstChunk == 0 ? decimalChunkDigits : firstChunk;
+    while(begin < number.size()) {
+        Limb chunk = 0;
+        Limb factor = 1;
+        for(size_t i = begin; i < end && i < number.size(); ++i) {
+            chunk = chunk * 10 + (number[i] - '0');
+            factor *= 10;
+        }
+        multiplyAddLimb(limbs, factor, chunk);
+        begin = end;
+        end += decimalChunkDigits;
     }
 
-    this->digits = number;
+    positive = sign;
+    normalize();
 }
 
 BigInt::BigInt(const long long number) {
-    if(number < 0) setSign(false);
-    this->digits = std::to_string(std::abs(number));
+    // Negate in unsigned arithmetic, so that INT64_MIN does not overflow
+    const Limb magnitude = number < 0 ? 0 - static_cast<Limb>(number) : static_cast<Limb>(number);
+    if(magnitude != 0) {
+        limbs.push_back(magnitude);
+    }
+    positive = number >= 0;
+}
+
+BigInt BigInt::fromLimbs(std::vector<Limb> limbs, const bool positive) {
+    BigInt result;
+    result.limbs = std::move(limbs);
+    result.positive = positive;
+    result.normalize();
+    return result;
+}
+
+BigInt BigInt::fromLimbs(const Limb *limbs, const size_t length, const bool positive) {
+    return fromLimbs(std::vector<Limb>(limbs, limbs + trimmedLength(limbs, length)), positive);
+}
+
+void BigInt::normalize() {
+    trimLimbs(limbs);
+    if(limbs.empty()) {
+        // There is no negative zero
+        positive = true;
+    }
 }
 
 std::ostream& operator<<(std::ostream& os, const BigInt& obj) {
@@ -39,8 +148,26 @@ std::ostream& operator<<(std::ostream& os, const BigInt& obj) {
     return os;
 }
 
-const std::string& BigInt::getDigits() const {
-    return digits;
+std::string BigInt::getDigits() const {
+    if(limbs.empty()) return "0";
+
+    std::vector<Limb> remaining = limbs;
+    std::vector<Limb> chunks;
+    while(!remaining.empty()) {
+        chunks.push_back(divideLimb(remaining, decimalChunk));
+    }
+
+    std::string result = std::to_string(chunks.back());
+    for(size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        result.append(decimalChunkDigits - chunk.size(), '0');
+        result.append(chunk);
+    }
+    return result;
+}
+
+const std::vector<Limb>& BigInt::getLimbs() const {
+    return limbs;
 }
 
 bool BigInt::isPositive() const{
@@ -48,18 +175,54 @@ bool BigInt::isPositive() const{
 }
 
 bool BigInt::isEven() const {
-    const int lastDigit = digits.back() - '0';
-    return (lastDigit % 2) == 0;
+    return limbs.empty() || (limbs[0] & 1) == 0;
+}
+
+bool BigInt::isZero() const {
+    return limbs.empty();
+}
+
+size_t BigInt::bitLength() const {
+    if(limbs.empty()) return 0;
+    return 64 * limbs.size() - __builtin_clzll(limbs.back());
 }
 
 
 void BigInt::setSign(bool sign) {
     positive = sign;
+    normalize();
+}
+
+Limb BigInt::modSmall(const Limb divisor) const {
+    if(limbs.size() <= 1) {
+        const Limb remainder = limbs.empty() ? 0 : limbs[0] % divisor;
+        return (positive || remainder == 0) ? remainder : divisor - remainder;
+    }
+    return modSmall(LimbDivisor(divisor));
+}
+
+Limb BigInt::modSmall(const LimbDivisor &divisor) const {
+    const Limb remainder = divisor.divide(nullptr, limbs.data(), limbs.size());
+    return (positive || remainder == 0) ? remainder : divisor.divisor - remainder;
+}
+
+Limb BigInt::divSmall(const Limb divisor) {
+    const Limb remainder = divideLimb(limbs.data(), limbs.data(), limbs.size(), divisor);
+    normalize();
+    return remainder;
+}
+
+Limb BigInt::divSmall(const LimbDivisor &divisor) {
+    const Limb remainder = divisor.divide(limbs.data(), limbs.data(), limbs.size());
+    normalize();
+    return remainder;
 }
 
 BigInt::operator long long() const {
-    assert(*this <= BigInt(INT64_MAX));
-    return positive ? std::stoll(digits) : -std::stoll(digits);
+    assert(limbs.size() <= 1);
+    if(limbs.empty()) return 0;
+    assert(limbs[0] <= static_cast<Limb>(INT64_MAX) || (!positive && limbs[0] == static_cast<Limb>(INT64_MAX) + 1));
+    return positive ? static_cast<long long>(limbs[0]) : static_cast<long long>(0 - limbs[0]);
 }
 
 
@@ -71,19 +234,24 @@ BigInt BigInt::abs(const BigInt &num) {
 }
 
 BigInt BigInt::gcd(const BigInt &lhs, const BigInt &rhs) {
-    if(rhs == BigInt(0)) return lhs;
-    return gcd(rhs, lhs % rhs);
+    const size_t length = std::max(lhs.limbs.size(), rhs.limbs.size());
+    std::vector<Limb> result = lhs.limbs;
+    std::vector<Limb> other = rhs.limbs;
+    result.resize(length);
+    other.resize(length);
+    std::vector<Limb> scratch(4 * length + 1);
+    result.resize(gcdLimbs(result.data(), other.data(), length, scratch.data()));
+    return fromLimbs(std::move(result));
 }
 
 BigInt BigInt::sqrt(const BigInt &num) {
+    if(num.isZero()) return 0;
 
-    std::string digits = "1";
-    for(int i = 0; i < num.getDigits().size() / 2; ++i) {
-        digits.append("0");
-    }
-    digits.append("0");
+    // 2^ceil(bits/2) is always larger than the root, so newton's method converges from above
+    std::vector<Limb> start((num.bitLength() + 1) / 2 / 64 + 1, 0);
+    start.back() = Limb(1) << (((num.bitLength() + 1) / 2) % 64);
 
-    BigInt x = BigInt(digits);
+    BigInt x = fromLimbs(std::move(start));
     BigInt y = x + num/x;
     y /= BigInt(2);
     while(y < x) {
@@ -109,63 +277,44 @@ BigInt BigInt::ceilSqrt(const BigInt &num) {
 
 BigInt BigInt::exp(const BigInt &base, const BigInt &exponent, const BigInt &modulus) {
     if(exponent <= BigInt(0)) return BigInt(1);
-    if(exponent == BigInt(1)) return base % modulus;
 
+    if(modulus.isPositive() && !modulus.isEven()) {
+        return Montgomery<BigInt>(modulus).exp(base, exponent);
+    }
 
-    if((exponent % BigInt(2)) == BigInt(0)) {
-        assert(((exponent.getDigits()[exponent.getDigits().size() - 1] - '0') % 2) == 0);
-
-        BigInt res = exp(base, exponent / BigInt(2), modulus) % modulus;
-
+    // Even moduli (and 0 for no reduction at all) fall back to square and multiply
+    BigInt res = 1;
+    for(size_t i = exponent.bitLength(); i-- > 0;) {
         res *= res;
         res %= modulus;
-
-        return std::move(res);
+        if((exponent.limbs[i / 64] >> (i % 64)) & 1) {
+            res *= base;
+            res %= modulus;
+        }
     }
-    auto res = exp(base, exponent - 1, modulus) % modulus;
-    res *= base;
-    res %= modulus;
     return std::move(res);
 }
 
 /**
- * Approximates the value of log2(num)
- * reference: https://stackoverflow.com/questions/8232932/logarithm-of-the-very-very-large-number
+ * Computes floor(log2(num)) from the position of the highest set bit
  */
 BigInt BigInt::log2(const BigInt &num) {
     assert(num > 0);
-    if(num.getDigits().size() <= 8) {
-        return static_cast<long long>(std::log(std::stoll(num.getDigits()))/std::log(2.0));
-    }
-
-    const auto msb = static_cast<long double>(num.getDigits()[0] - '0');
-    const auto smsb = static_cast<long double>(num.getDigits()[1] - '0');
-    long double res = std::log(msb*10.0l + smsb) / std::log(2.0l);
-    res += 3.32192809l * static_cast<long double>(num.getDigits().size() - 2);
-    const auto intRes = static_cast<long long>(res);
-    return BigInt(intRes);
+    return static_cast<long long>(num.bitLength() - 1);
 }
 
 BigInt BigInt::modInverse(const BigInt &num, const BigInt &mod) {
-    assert(num != 0);
-    BigInt t = 0;
-    BigInt r = mod;
-    BigInt newT = 1;
-    BigInt newR = num;
-
-    while(newR != 0) {
-        BigInt q = r / newR;
-        BigInt updateT = t - q * newT;
-        BigInt updateR = r - q * newR;
-        t = std::move(newT);
-        r = std::move(newR);
-        newT = std::move(updateT);
-        newR = std::move(updateR);
+    assert(num != 0 && mod > 0);
+    const size_t length = mod.limbs.size();
+    std::vector<Limb> reduced = (num % mod).limbs;
+    std::vector<Limb> modulus = mod.limbs;
+    reduced.resize(length);
+    std::vector<Limb> result(length);
+    std::vector<Limb> scratch(6 * length + 1);
+    if(!modInverseLimbs(result.data(), reduced.data(), modulus.data(), length, scratch.data())) {
+        return 0;
     }
-
-    if(t < 0) t+= mod;
-
-    return std::move(t);
+    return fromLimbs(std::move(result));
 }
 
 
@@ -176,7 +325,7 @@ bool BigInt::operator==(const BigInt &other) const {
         return false;
     }
 
-    return this->digits == other.digits;
+    return this->limbs == other.limbs;
 }
 
 bool BigInt::operator!=(const BigInt &other) const {
@@ -184,29 +333,13 @@ bool BigInt::operator!=(const BigInt &other) const {
 }
 
 /**
- * Compares to digit strings.
- * @return -1 if lhs < rhs
- *          0 if lhs == rhs
- *          1 if lhs > rhs
+ * Compares the absolute values of two numbers.
+ * @return -1 if |lhs| < |rhs|
+ *          0 if |lhs| == |rhs|
+ *          1 if |lhs| > |rhs|
  */
-int BigInt::stringComp(const std::string &lhs, const std::string &rhs) {
-    if(lhs.size() < rhs.size()) {
-        return -1;
-    }
-
-    if(rhs.size() < lhs.size()) {
-        return 1;
-    }
-
-    for(int i = 0; i < lhs.size(); ++i) {
-        if(lhs[i] < rhs[i]) {
-            return -1;
-        }
-        if(lhs[i] > rhs[i]) {
-            return 1;
-        }
-    }
-    return 0;
+int BigInt::compareMagnitude(const BigInt &lhs, const BigInt &rhs) {
+    return compareLimbs(lhs.limbs, rhs.limbs);
 }
 
 
@@ -216,14 +349,7 @@ bool BigInt::operator<(const BigInt &rhs) const {
         return !this->positive;
     }
 
-    if(this->digits.size() != rhs.digits.size()) {
-        if(this->digits.size() > rhs.digits.size()) {
-            return !this->positive;
-        }
-        return this->positive;
-    }
-
-    const int result = stringComp(digits, rhs.digits);
+    const int result = compareMagnitude(*this, rhs);
     if(positive) {
         return result == -1;
     }
@@ -260,114 +386,41 @@ BigInt operator+(BigInt lhs, const BigInt &rhs) {
 
 BigInt &BigInt::operator+=(const BigInt &rhs) {
 
-    if(!rhs.isPositive()) {
-        BigInt copy = rhs;
-        copy.positive = true;
-        *this -= copy;
+    if(positive == rhs.positive) {
+        addLimbs(limbs, rhs.limbs);
         return *this;
     }
 
-    if(!isPositive()) {
-        BigInt copy = rhs;
-        positive = true;
-        copy -= *this;
-        *this = copy;
-        return *this;
+    // Signs differ, so the smaller magnitude is subtracted from the larger one
+    if(compareLimbs(limbs, rhs.limbs) >= 0) {
+        subtractLimbs(limbs, rhs.limbs);
+    } else {
+        std::vector<Limb> result = rhs.limbs;
+        subtractLimbs(result, limbs);
+        limbs = std::move(result);
+        positive = rhs.positive;
     }
-
-    const unsigned long long maxLen = std::max(rhs.digits.size(), digits.size());
-
-    std::string additionalDigits;
-
-    int carry = 0;
-    for(int i = 0; i < maxLen; ++i) {
-
-        int leftDigit = 0;
-        if(i < digits.size()) {
-            leftDigit = digits[digits.size() - i - 1] - '0';
-        }
-        int rightDigit = 0;
-        if(i < rhs.digits.size()) {
-            rightDigit = rhs.digits[rhs.digits.size() - i - 1] - '0';
-        }
-
-        const int sum = leftDigit + rightDigit + carry;
-        carry = sum / 10;
-
-
-        if(i < digits.size()) {
-            digits[digits.size() - i - 1] = (sum % 10) + '0';
-        } else {
-            additionalDigits += (sum % 10) + '0';
-        }
-    }
-
-    if(carry != 0) {
-        additionalDigits += '1';
-    }
-
-    std::ranges::reverse(additionalDigits);
-    this->digits.insert(0, additionalDigits);
-
+    normalize();
 
     return *this;
 }
 
 BigInt &BigInt::operator-=(const BigInt &rhs) {
 
-    if(!rhs.isPositive()) {
-        BigInt copy = rhs;
-        copy.positive = true;
-        *this += copy;
+    if(positive != rhs.positive) {
+        addLimbs(limbs, rhs.limbs);
         return *this;
     }
 
-    if(!isPositive()) {
-        positive = true;
-        *this += rhs;
-        positive = false;
-        return *this;
-    }
-
-    if(*this < rhs) {
-        BigInt result = rhs;
-        result -= *this;
-        result.positive = false;
-        *this = std::move(result);
-        return *this;
-    }
-
-    std::string resDigits;
-    int carry = 0;
-    for(int i = 0; i < digits.size(); ++i) {
-
-        int leftDigit = digits[digits.size() - i - 1] - '0';
-
-        int rightDigit = 0;
-        if(i < rhs.digits.size()) {
-            rightDigit = rhs.digits[rhs.digits.size() - i - 1] - '0';
-        }
-
-        int res = leftDigit - rightDigit - carry;
-        carry = 0;
-        if(res < 0) {
-            carry = 1;
-            res += 10;
-        }
-
-        resDigits += res + '0';
-    }
-
-    while(!resDigits.empty() && resDigits.back() == '0') {
-        resDigits.pop_back();
-    }
-    if(resDigits.empty()) {
-        resDigits = "0";
+    if(compareLimbs(limbs, rhs.limbs) >= 0) {
+        subtractLimbs(limbs, rhs.limbs);
+    } else {
+        std::vector<Limb> result = rhs.limbs;
+        subtractLimbs(result, limbs);
+        limbs = std::move(result);
+        positive = !positive;
     }
-    std::ranges::reverse(resDigits);
-    digits = std::move(resDigits);
-
-
+    normalize();
 
     return *this;
 }
@@ -379,110 +432,54 @@ BigInt operator-(BigInt lhs, const BigInt &rhs) {
 
 
 BigInt multiplyDigit(const BigInt &lhs, const char digit) {
-    BigInt result;
-
-    const int digitNum = digit - '0';
-    std::string padding;
-    for(int i = lhs.getDigits().size() - 1; i >= 0; --i) {
-
-        const int lhsDigit = lhs.getDigits()[i] - '0';
-        std::string res = std::to_string(lhsDigit * digitNum);
-
-        res.append(padding);
-        result += BigInt(res);
-
-        padding += '0';
-    }
-    return std::move(result);
+    return lhs * BigInt(digit - '0');
 }
 
 /**
- * Helper function for multiplication
+ * Helper function for multiplication, splits off the limbs [begin, end)
  */
-inline std::string extractHighNumber(const int middle, const int maxLen, const BigInt &number) {
-    std::string high = "0";
-    const int digitSize = number.getDigits().size();
-    for(int i = 0; i < middle - (maxLen - digitSize); ++i) {
-        high += number.getDigits()[i];
-    }
-    return std::move(high);
+inline std::vector<Limb> extractLimbs(const std::vector<Limb> &limbs, const size_t begin, const size_t end) {
+    if(begin >= limbs.size()) return {};
+    std::vector<Limb> result(limbs.begin() + begin, limbs.begin() + std::min(end, limbs.size()));
+    trimLimbs(result);
+    return result;
 }
 
 
-BigInt karatsubaMultiply(const BigInt &lhs, const BigInt &rhs) {
-
-    if(lhs.getDigits().size() <= 9 && rhs.getDigits().size() <= 9) {
-        const long long result = std::stoll(lhs.getDigits()) * std::stoll(rhs.getDigits());
-        return BigInt(result);
-    }
+std::vector<Limb> karatsubaMultiply(const std::vector<Limb> &lhs, const std::vector<Limb> &rhs) {
 
-    if(lhs.getDigits().size() == 1) {
-        BigInt res = multiplyDigit(rhs, lhs.getDigits()[0]);
-        return std::move(res);
+    if(lhs.size() < karatsubaThreshold || rhs.size() < karatsubaThreshold) {
+        return schoolbookMultiply(lhs, rhs);
     }
-    if(rhs.getDigits().size() == 1) {
-        BigInt res = multiplyDigit(lhs, rhs.getDigits()[0]);
-        return std::move(res);
-    }
-
-    int maxLen = std::max(lhs.getDigits().size(), rhs.getDigits().size());
-    int middle = maxLen / 2;
 
+    const size_t middle = std::max(lhs.size(), rhs.size()) / 2;
 
-    std::string high1 = extractHighNumber(middle, maxLen, lhs);
-    std::string high2 = extractHighNumber(middle, maxLen, rhs);
+    std::vector<Limb> lhs0 = extractLimbs(lhs, 0, middle);
+    std::vector<Limb> lhs1 = extractLimbs(lhs, middle, lhs.size());
+    std::vector<Limb> rhs0 = extractLimbs(rhs, 0, middle);
+    std::vector<Limb> rhs1 = extractLimbs(rhs, middle, rhs.size());
 
-    int lhsDigitSize = lhs.getDigits().size();
-    int rhsDigitSIze = rhs.getDigits().size();
-    int begin1 = std::max(0, middle - (maxLen - lhsDigitSize));
-    int begin2 = std::max(0, middle - (maxLen - rhsDigitSIze));
+    std::vector<Limb> z2 = karatsubaMultiply(lhs1, rhs1);
+    std::vector<Limb> z0 = karatsubaMultiply(lhs0, rhs0);
 
-    std::string low1 = lhs.getDigits().substr(begin1);
-    std::string low2 = rhs.getDigits().substr(begin2);
+    addLimbs(lhs0, lhs1);
+    addLimbs(rhs0, rhs1);
+    std::vector<Limb> z1 = karatsubaMultiply(lhs0, rhs0);
+    subtractLimbs(z1, z2);
+    subtractLimbs(z1, z0);
 
-
-    BigInt rhs1(std::move(high2));
-    BigInt rhs0(std::move(low2));
-    BigInt lhs1(std::move(high1));
-    BigInt lhs0(std::move(low1));
-
-
-    BigInt z3 = karatsubaMultiply(rhs1 + rhs0, lhs1 + lhs0);
-    BigInt z2 = karatsubaMultiply(rhs1, lhs1);
-    BigInt z0 = karatsubaMultiply(rhs0, lhs0);
-
-    std::string padding;
-
-    for(int i = 0; i < maxLen - middle; ++i) {
-        padding += '0';
-    }
-
-    BigInt result;
-
-    result += z0;
-
-    BigInt z1 = z3 - z2 - z0;
-    std::string digits = z1.getDigits();
-    digits.append(padding);
-    result += BigInt(std::move(digits));
-
-
-    digits = z2.getDigits();
-    padding += padding;
-    digits.append(padding);
-    result += BigInt(std::move(digits));
+    std::vector<Limb> result = std::move(z0);
+    addLimbs(result, z1, middle);
+    addLimbs(result, z2, 2 * middle);
+    trimLimbs(result);
 
     return result;
 }
 
 
 BigInt operator*(const BigInt& lhs, const BigInt &rhs) {
-    BigInt result = karatsubaMultiply(lhs, rhs);
-    if(lhs.isPositive() != rhs.isPositive()) {
-        result.setSign(false);
-    }
-
-    return std::move(result);
+    return BigInt::fromLimbs(karatsubaMultiply(lhs.limbs, rhs.limbs),
+                             lhs.isPositive() == rhs.isPositive());
 }
 
 BigInt &BigInt::operator*=(const BigInt &rhs) {
@@ -491,75 +488,36 @@ BigInt &BigInt::operator*=(const BigInt &rhs) {
 }
 
 /**
- * Divides lhs by rhs. Assumes, that rhs has at least as many digits as lhs.
- * Therefore, the result can be at most 9
+ * Divides lhs by rhs, where the quotient is expected to be small.
  */
 long long smallDivide(const BigInt &lhs, const BigInt &rhs) {
-    if(lhs.getDigits().size() < rhs.getDigits().size()) {
+    if(BigInt::compareMagnitude(lhs, rhs) < 0) {
         return 0;
     }
 
-    long long result = 0;
-    BigInt rhsCopy = rhs;
-    while(BigInt::stringComp(rhsCopy.getDigits(), lhs.getDigits()) <= 0) {
-        result++;
-        rhsCopy += rhs;
-    }
-
-    return result;
+    return static_cast<long long>(BigInt::divmod(BigInt::abs(lhs), BigInt::abs(rhs)).first);
 }
 
-BigInt &BigInt::operator/=(BigInt rhs) {
-    const bool sign = isPositive() == rhs.isPositive();
-
-    // calculations are done with the absolute values
-    setSign(true);
-    rhs.setSign(true);
+std::pair<BigInt, BigInt> BigInt::divmod(const BigInt &lhs, const BigInt &rhs) {
+    assert(!rhs.isZero());
 
-    if(*this < rhs) {
-        *this = BigInt(0);
-        return *this;
+    if(compareLimbs(lhs.limbs, rhs.limbs) < 0) {
+        return {BigInt(0), lhs};
     }
 
-    if(getDigits() == rhs.getDigits()) {
-        *this = BigInt(1);
-        setSign(sign);
-        return *this;
-    }
+    std::vector<Limb> quotient(lhs.limbs.size());
+    std::vector<Limb> remainder(rhs.limbs.size());
+    // Only divisors with more than one limb need the normalized copies
+    std::vector<Limb> scratch(rhs.limbs.size() > 1 ? lhs.limbs.size() + rhs.limbs.size() + 1 : 0);
+    divideLimbs(quotient.data(), remainder.data(), lhs.limbs.data(), lhs.limbs.size(),
+                rhs.limbs.data(), rhs.limbs.size(), scratch.data());
 
-    std::string resultDigits;
-
-    int index = rhs.getDigits().size();
-
-    auto newDigits = BigInt(getDigits().substr(0, index));
-    index--;
-
-    while(index < getDigits().size()) {
-        std::string digits = newDigits.getDigits();
-        bool added = false;
-        while(index + 1 < getDigits().size() && stringComp(digits, rhs.getDigits()) == -1) {
-
-            if(added) resultDigits.append("0");
-
-            digits += getDigits()[++index];
-            added = true;
-        }
-
-
-        newDigits = BigInt(std::move(digits));
-        const long long cnt = smallDivide(newDigits, rhs);
-        newDigits = newDigits - rhs * BigInt(cnt);
-
-
-        resultDigits += std::to_string(cnt);
-        if(index == getDigits().size() - 1) break;
-    }
-
-    digits = std::move(resultDigits);
-
-    // Set sign to expected value
-    setSign(sign);
+    return {fromLimbs(std::move(quotient), lhs.positive == rhs.positive),
+            fromLimbs(std::move(remainder), lhs.positive)};
+}
 
+BigInt &BigInt::operator/=(BigInt rhs) {
+    *this = std::move(divmod(*this, rhs).first);
     return *this;
 }
 
@@ -577,17 +535,10 @@ BigInt &BigInt::operator%=(const BigInt &rhs) {
 
 BigInt operator%(const BigInt &lhs, const BigInt &rhs) {
     if(rhs == 0) return lhs;
-    BigInt res = lhs - rhs * (lhs/rhs);
+    BigInt res = std::move(BigInt::divmod(lhs, rhs).second);
     if(!res.isPositive()) {
         // Make result positive
-        res += ((res/rhs) + BigInt(1)) * rhs;
+        res += BigInt::abs(rhs);
     }
     return std::move(res);
 }
-
-
-
-
-
-
-
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
+
+#include "limb_arithmetic.h"
 
 class BigInt {
 public:
@@ -36,31 +40,62 @@ public:
 
     explicit operator long long() const;
 
-    [[nodiscard]] const std::string& getDigits() const;
+    /**
+     * Computes *this % divisor for a single limb divisor without building a BigInt for it.
+     * Like operator%, the result is never negative.
+     */
+    [[nodiscard]] Limb modSmall(Limb divisor) const;
+    [[nodiscard]] Limb modSmall(const LimbDivisor &divisor) const;
+
+    /**
+     * Divides in place by a single limb divisor, rounding towards zero.
+     * @return The remainder of the absolute value
+     */
+    Limb divSmall(Limb divisor);
+    Limb divSmall(const LimbDivisor &divisor);
+
+    /**
+     * Decimal representation of the absolute value. Only meant for printing and tests,
+     * all arithmetic is done on the binary limbs.
+     */
+    [[nodiscard]] std::string getDigits() const;
+    [[nodiscard]] const std::vector<Limb>& getLimbs() const;
     [[nodiscard]] bool isPositive() const;
     [[nodiscard]] bool isEven() const;
+    [[nodiscard]] bool isZero() const;
+    [[nodiscard]] size_t bitLength() const;
 
     void setSign(bool sign);
 
+    static BigInt fromLimbs(std::vector<Limb> limbs, bool positive = true);
+    static BigInt fromLimbs(const Limb *limbs, size_t length, bool positive = true);
+
     static BigInt abs(const BigInt &num);
     static BigInt gcd(const BigInt &lhs, const BigInt &rhs);
     static BigInt sqrt(const BigInt &num);
     static BigInt ceilSqrt(const BigInt &num);
     static BigInt exp(const BigInt &base, const BigInt &exponent, const BigInt &modulus);
     static BigInt log2(const BigInt &num);
+    /**
+     * @return 0 if num has no inverse
+     */
     static BigInt modInverse(const BigInt &num, const BigInt &mod);
-    static int stringComp(const std::string &lhs, const std::string &rhs);
+    /**
+     * Truncating division. Returns the quotient and the remainder lhs - quotient*rhs, which has
+     * the sign of lhs (unlike operator%, which is never negative).
+     */
+    static std::pair<BigInt, BigInt> divmod(const BigInt &lhs, const BigInt &rhs);
+    static int compareMagnitude(const BigInt &lhs, const BigInt &rhs);
 
 private:
-    std::string digits = "0";
+    // Little endian base 2^64 digits without leading zero limbs. Zero has no limbs.
+    std::vector<Limb> limbs;
     bool positive = true;
 
+    void normalize();
 };
 
 std::ostream &operator<<(std::ostream &os, const BigInt &obj);
 
 BigInt multiplyDigit(const BigInt &lhs, char digit);
 long long smallDivide(const BigInt &lhs, const BigInt &rhs);
-
-
-
@@ -0,0 +1,557 @@
+#include "block_lanczos.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+
+// n x 64 matrix over GF(2), one word per row. Holds 64 vectors of length n side by side.
+using Block = std::vector<uint64_t>;
+// 64 x 64 matrix over GF(2), bit j of entry i is the entry in row i and column j
+using Matrix64 = std::array<uint64_t, 64>;
+
+
+SparseMatrix buildSparseMatrix(const std::vector<std::vector<int>> &factorizationExponents) {
+    SparseMatrix matrix;
+    matrix.rowCount = factorizationExponents.empty() ? 0 : factorizationExponents[0].size();
+    matrix.columnStarts.push_back(0);
+    for(const auto &exponents : factorizationExponents) {
+        for(size_t i = 0; i < exponents.size(); ++i) {
+            if(exponents[i] & 1) {
+                matrix.rows.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        matrix.columnStarts.push_back(static_cast<uint32_t>(matrix.rows.size()));
+    }
+    return matrix;
+}
+
+/**
+ * Threads that stay alive for a whole Block Lanczos run. Every iteration needs two products
+ * split over the threads, starting new threads for each of them would cost about as much as
+ * the products on mid-sized matrices.
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(const unsigned threads) {
+        for(unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back(&WorkerPool::runWorker, this, i);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for(auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * Splits [0, count) into one range per thread and calls work(begin, end) for every range.
+     * The calling thread takes the first range.
+     */
+    void parallelFor(const size_t count, const std::function<void(size_t, size_t)> &work) {
+        if(workers.empty() || count < 4096) {
+            work(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            task = &work;
+            taskCount = count;
+            pending = workers.size();
+            generation++;
+        }
+        started.notify_all();
+
+        work(0, std::min(partSize(count), count));
+
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable started, finished;
+    const std::function<void(size_t, size_t)> *task = nullptr;
+    size_t taskCount = 0;
+    size_t pending = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    [[nodiscard]] size_t partSize(const size_t count) const {
+        return (count + workers.size()) / (workers.size() + 1);
+    }
+
+    void runWorker(const size_t index) {
+        uint64_t seen = 0;
+        while(true) {
+            std::unique_lock lock(mutex);
+            started.wait(lock, [&] { return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+            const auto *work = task;
+            const size_t count = taskCount;
+            lock.unlock();
+
+            const size_t part = partSize(count);
+            const size_t begin = index * part;
+            if(begin < count) {
+                (*work)(begin, std::min(begin + part, count));
+            }
+
+            lock.lock();
+            if(--pending == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+};
+
+Matrix64 multiplyMatrix64(const Matrix64 &lhs, const Matrix64 &rhs) {
+    Matrix64 result{};
+    for(int i = 0; i < 64; ++i) {
+        for(uint64_t bits = lhs[i]; bits != 0; bits &= bits - 1) {
+            result[i] ^= rhs[__builtin_ctzll(bits)];
+        }
+    }
+    return result;
+}
+
+/**
+ * result ^= block * matrix. Every byte of a row selects one of 256 precomputed sums of 8 rows
+ * of matrix.
+ */
+void multiplyBlockMatrix(const Block &block, const Matrix64 &matrix, Block &result) {
+    std::array<std::array<uint64_t, 256>, 8> sums;
+    for(int k = 0; k < 8; ++k) {
+        sums[k][0] = 0;
+        for(int byte = 1; byte < 256; ++byte) {
+            sums[k][byte] = sums[k][byte & (byte - 1)] ^ matrix[8 * k + __builtin_ctz(byte)];
+        }
+    }
+
+    for(size_t i = 0; i < block.size(); ++i) {
+        const uint64_t row = block[i];
+        uint64_t sum = 0;
+        for(int k = 0; k < 8; ++k) {
+            sum ^= sums[k][(row >> (8 * k)) & 255];
+        }
+        result[i] ^= sum;
+    }
+}
+
+/**
+ * Computes lhs^T * rhs. The rows of rhs are first added up by the bytes of the rows of lhs, which
+ * leaves only 8 * 256 sums to distribute at the end.
+ */
+Matrix64 blockInnerProduct(const Block &lhs, const Block &rhs) {
+    std::array<std::array<uint64_t, 256>, 8> sums{};
+    for(size_t i = 0; i < lhs.size(); ++i) {
+        for(int k = 0; k < 8; ++k) {
+            sums[k][(lhs[i] >> (8 * k)) & 255] ^= rhs[i];
+        }
+    }
+
+    Matrix64 result{};
+    for(int k = 0; k < 8; ++k) {
+        for(int byte = 1; byte < 256; ++byte) {
+            for(int bits = byte; bits != 0; bits &= bits - 1) {
+                result[8 * k + __builtin_ctz(bits)] ^= sums[k][byte];
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Chooses the columns S of vAv = V^T A V for the next step and inverts vAv restricted to them
+ * (Montgomery, section 8). Columns that were not chosen last time must be chosen now, so they
+ * are tried first.
+ * @return false if there is no such choice, Lanczos has failed then
+ */
+bool selectSubspace(const Matrix64 &vAv, const uint64_t lastSelected, Matrix64 &inverse, uint64_t &selected) {
+    // [vAv | I], reduced until the right half holds the inverse
+    std::array<std::array<uint64_t, 2>, 64> rows;
+    for(int i = 0; i < 64; ++i) {
+        rows[i] = {vAv[i], uint64_t(1) << i};
+    }
+
+    std::array<int, 64> order;
+    int count = 0;
+    for(int i = 0; i < 64; ++i) {
+        if(!((lastSelected >> i) & 1)) order[count++] = i;
+    }
+    for(int i = 0; i < 64; ++i) {
+        if((lastSelected >> i) & 1) order[count++] = i;
+    }
+
+    selected = 0;
+    for(int i = 0; i < 64; ++i) {
+        const int column = order[i];
+        const uint64_t bit = uint64_t(1) << column;
+
+        int pivot = i;
+        while(pivot < 64 && !(rows[order[pivot]][0] & bit)) {
+            ++pivot;
+        }
+        if(pivot < 64) {
+            std::swap(rows[column], rows[order[pivot]]);
+            for(int k = 0; k < 64; ++k) {
+                if(k != column && (rows[k][0] & bit)) {
+                    rows[k][0] ^= rows[column][0];
+                    rows[k][1] ^= rows[column][1];
+                }
+            }
+            selected |= bit;
+            continue;
+        }
+
+        // No pivot on the left, the column is left out. A pivot on the right keeps the other
+        // rows of the inverse consistent.
+        pivot = i;
+        while(pivot < 64 && !(rows[order[pivot]][1] & bit)) {
+            ++pivot;
+        }
+        if(pivot == 64) return false;
+
+        std::swap(rows[column], rows[order[pivot]]);
+        for(int k = 0; k < 64; ++k) {
+            if(k != column && (rows[k][1] & bit)) {
+                rows[k][0] ^= rows[column][0];
+                rows[k][1] ^= rows[column][1];
+            }
+        }
+        rows[column] = {0, 0};
+    }
+
+    for(int i = 0; i < 64; ++i) {
+        inverse[i] = rows[i][1];
+    }
+    return true;
+}
+
+/**
+ * Products with the matrix B, its transpose and A = B^T B, which is symmetric as Lanczos
+ * requires. Rows and columns are both split over threads, no thread writes to a word another
+ * one writes.
+ */
+class LanczosMatrix {
+public:
+    LanczosMatrix(const SparseMatrix &matrix, WorkerPool &pool) : matrix(matrix), pool(pool) {
+        // The compressed row form of the same matrix, for B * block
+        rowStarts.assign(matrix.rowCount + 1, 0);
+        for(const uint32_t row : matrix.rows) {
+            rowStarts[row + 1]++;
+        }
+        for(size_t i = 0; i < matrix.rowCount; ++i) {
+            rowStarts[i + 1] += rowStarts[i];
+        }
+        columns.resize(matrix.rows.size());
+        std::vector<uint32_t> next(rowStarts.begin(), rowStarts.end() - 1);
+        for(size_t column = 0; column < matrix.columnCount(); ++column) {
+            for(uint32_t i = matrix.columnStarts[column]; i < matrix.columnStarts[column + 1]; ++i) {
+                columns[next[matrix.rows[i]]++] = static_cast<uint32_t>(column);
+            }
+        }
+        scratch.resize(matrix.rowCount);
+    }
+
+    /**
+     * result = B * block, with rowCount rows
+     */
+    void multiplyB(const Block &block, Block &result) const {
+        pool.parallelFor(matrix.rowCount, [&](const size_t begin, const size_t end) {
+            for(size_t row = begin; row < end; ++row) {
+                uint64_t sum = 0;
+                for(uint32_t i = rowStarts[row]; i < rowStarts[row + 1]; ++i) {
+                    sum ^= block[columns[i]];
+                }
+                result[row] = sum;
+            }
+        });
+    }
+
+    /**
+     * result = A * block = B^T * (B * block)
+     */
+    void multiplyA(const Block &block, Block &result) {
+        multiplyB(block, scratch);
+        pool.parallelFor(matrix.columnCount(), [&](const size_t begin, const size_t end) {
+            for(size_t column = begin; column < end; ++column) {
+                uint64_t sum = 0;
+                for(uint32_t i = matrix.columnStarts[column]; i < matrix.columnStarts[column + 1]; ++i) {
+                    sum ^= scratch[matrix.rows[i]];
+                }
+                result[column] = sum;
+            }
+        });
+    }
+
+private:
+    const SparseMatrix &matrix;
+    WorkerPool &pool;
+    std::vector<uint32_t> rowStarts, columns;
+    Block scratch;
+};
+
+/**
+ * After Lanczos, A x = 0 and A v = 0 hold up to a few vectors, B x and B v are not zero yet.
+ * Finds the combinations of the 128 columns of x and v that B maps to zero.
+ */
+std::vector<std::set<int>> combineNullVectors(const LanczosMatrix &matrix, const size_t rowCount,
+                                              const Block &x, const Block &v) {
+    using Bits128 = unsigned __int128;
+    const auto lowestBit = [](const Bits128 bits) {
+        const auto low = static_cast<uint64_t>(bits);
+        return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll(static_cast<uint64_t>(bits >> 64));
+    };
+
+    Block bx(rowCount), bv(rowCount);
+    matrix.multiplyB(x, bx);
+    matrix.multiplyB(v, bv);
+
+    // Row echelon form of [B x | B v], every basis row is reduced by all rows before it
+    std::vector<Bits128> basis;
+    std::vector<int> pivots;
+    for(size_t i = 0; i < rowCount && basis.size() < 128; ++i) {
+        Bits128 row = bx[i] | (static_cast<Bits128>(bv[i]) << 64);
+        for(size_t k = 0; k < basis.size(); ++k) {
+            if((row >> pivots[k]) & 1) row ^= basis[k];
+        }
+        if(row != 0) {
+            basis.push_back(row);
+            pivots.push_back(lowestBit(row));
+        }
+    }
+    for(size_t k = basis.size(); k-- > 0;) {
+        for(size_t j = 0; j < k; ++j) {
+            if((basis[j] >> pivots[k]) & 1) basis[j] ^= basis[k];
+        }
+    }
+
+    // Every column without a pivot gives one combination
+    Bits128 pivotColumns = 0;
+    for(const int pivot : pivots) {
+        pivotColumns |= static_cast<Bits128>(1) << pivot;
+    }
+    Matrix64 xCombinations{}, vCombinations{};
+    int count = 0;
+    for(int column = 0; column < 128 && count < 64; ++column) {
+        if((pivotColumns >> column) & 1) continue;
+        Bits128 combination = static_cast<Bits128>(1) << column;
+        for(size_t k = 0; k < basis.size(); ++k) {
+            if((basis[k] >> column) & 1) combination |= static_cast<Bits128>(1) << pivots[k];
+        }
+        for(int j = 0; j < 64; ++j) {
+            xCombinations[j] |= static_cast<uint64_t>((combination >> j) & 1) << count;
+            vCombinations[j] |= static_cast<uint64_t>((combination >> (64 + j)) & 1) << count;
+        }
+        ++count;
+    }
+
+    Block dependencies(x.size());
+    multiplyBlockMatrix(x, xCombinations, dependencies);
+    multiplyBlockMatrix(v, vCombinations, dependencies);
+
+    // Only keep what really is in the null space of B
+    Block check(rowCount);
+    matrix.multiplyB(dependencies, check);
+    uint64_t failed = 0;
+    for(const uint64_t row : check) {
+        failed |= row;
+    }
+
+    std::vector<std::set<int>> result;
+    for(int k = 0; k < count; ++k) {
+        if((failed >> k) & 1) continue;
+        std::set<int> dependency;
+        for(size_t i = 0; i < dependencies.size(); ++i) {
+            if((dependencies[i] >> k) & 1) dependency.emplace(static_cast<int>(i));
+        }
+        if(!dependency.empty() && std::find(result.begin(), result.end(), dependency) == result.end()) {
+            result.emplace_back(std::move(dependency));
+        }
+    }
+    return result;
+}
+
+/**
+ * One run of Block Lanczos from a random start.
+ * @return Empty if Lanczos failed
+ */
+std::vector<std::set<int>> runLanczos(LanczosMatrix &matrix, const size_t rowCount, const size_t columnCount,
+                                      std::mt19937_64 &random) {
+    // Solving A x = A y for a random y gives x - y in the null space of A
+    Block y(columnCount);
+    for(auto &row : y) {
+        row = random();
+    }
+    Block v0(columnCount);
+    matrix.multiplyA(y, v0);
+
+    Block v = v0, av(columnCount), x(columnCount), next(columnCount);
+    Block previous(columnCount), beforePrevious(columnCount);
+    Matrix64 inversePrevious{}, inverseBeforePrevious{}, vAvPrevious{}, vAAvPrevious{};
+    uint64_t selectedPrevious = ~uint64_t(0);
+
+    // Every step covers close to 64 dimensions
+    const size_t maxSteps = columnCount / 60 + 20;
+    for(size_t step = 0;; ++step) {
+        if(step > maxSteps) return {};
+
+        matrix.multiplyA(v, av);
+        const Matrix64 vAv = blockInnerProduct(v, av);
+        if(std::all_of(vAv.begin(), vAv.end(), [](const uint64_t row) { return row == 0; })) break;
+        const Matrix64 vAAv = blockInnerProduct(av, av);
+
+        Matrix64 inverse;
+        uint64_t selected;
+        if(!selectSubspace(vAv, selectedPrevious, inverse, selected)) return {};
+
+        // x += V_i W_i^-1 V_i^T V_0
+        multiplyBlockMatrix(v, multiplyMatrix64(inverse, blockInnerProduct(v, v0)), x);
+
+        // The coefficients of the three term recurrence. Signs do not matter over GF(2).
+        Matrix64 d, e, f, masked;
+        for(int i = 0; i < 64; ++i) {
+            masked[i] = (vAAv[i] & selected) ^ vAv[i];
+        }
+        d = multiplyMatrix64(inverse, masked);
+        for(int i = 0; i < 64; ++i) {
+            d[i] ^= uint64_t(1) << i;
+            masked[i] = vAv[i] & selected;
+        }
+        e = multiplyMatrix64(inversePrevious, masked);
+
+        Matrix64 left = multiplyMatrix64(vAvPrevious, inversePrevious);
+        for(int i = 0; i < 64; ++i) {
+            left[i] ^= uint64_t(1) << i;
+            masked[i] = (vAAvPrevious[i] & selectedPrevious) ^ vAvPrevious[i];
+        }
+        f = multiplyMatrix64(left, masked);
+        for(int i = 0; i < 64; ++i) {
+            f[i] &= selected;
+        }
+        f = multiplyMatrix64(inverseBeforePrevious, f);
+
+        // V_{i+1} = A V_i S_i S_i^T + V_i D + V_{i-1} E + V_{i-2} F
+        for(size_t i = 0; i < columnCount; ++i) {
+            next[i] = av[i] & selected;
+        }
+        multiplyBlockMatrix(v, d, next);
+        multiplyBlockMatrix(previous, e, next);
+        multiplyBlockMatrix(beforePrevious, f, next);
+
+        std::swap(beforePrevious, previous);
+        std::swap(previous, v);
+        std::swap(v, next);
+        inverseBeforePrevious = inversePrevious;
+        inversePrevious = inverse;
+        vAvPrevious = vAv;
+        vAAvPrevious = vAAv;
+        selectedPrevious = selected;
+    }
+
+    for(size_t i = 0; i < columnCount; ++i) {
+        x[i] ^= y[i];
+    }
+    return combineNullVectors(matrix, rowCount, x, v);
+}
+
+/**
+ * A column with the only entry of some row can not be part of any dependency. Lanczos works on
+ * A = B^T B, whose null space grows with every such column, and the dependencies of B get lost
+ * among those of A. So they are removed, until no such column is left. Empty columns would blow
+ * up the null space the same way, but they are relations that are squares already, so they are
+ * taken out as dependencies of their own.
+ * @param emptyColumns Receives the indices of the empty columns
+ * @return The indices of the remaining columns
+ */
+std::vector<uint32_t> removeSingletons(const SparseMatrix &matrix, SparseMatrix &reduced,
+                                       std::vector<uint32_t> &emptyColumns) {
+    std::vector<bool> removed(matrix.columnCount());
+    std::vector<uint32_t> rowWeights(matrix.rowCount);
+    for(const uint32_t row : matrix.rows) {
+        rowWeights[row]++;
+    }
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t column = 0; column < matrix.columnCount(); ++column) {
+            if(removed[column]) continue;
+            const auto begin = matrix.rows.begin() + matrix.columnStarts[column];
+            const auto end = matrix.rows.begin() + matrix.columnStarts[column + 1];
+            if(begin != end && std::none_of(begin, end, [&](const uint32_t row) { return rowWeights[row] == 1; })) continue;
+
+            removed[column] = true;
+            changed = true;
+            if(begin == end) {
+                emptyColumns.push_back(static_cast<uint32_t>(column));
+            }
+            for(auto row = begin; row != end; ++row) {
+                rowWeights[*row]--;
+            }
+        }
+    }
+
+    std::vector<uint32_t> columns;
+    reduced.rowCount = matrix.rowCount;
+    reduced.columnStarts = {0};
+    reduced.rows.clear();
+    for(size_t column = 0; column < matrix.columnCount(); ++column) {
+        if(removed[column]) continue;
+        columns.push_back(static_cast<uint32_t>(column));
+        reduced.rows.insert(reduced.rows.end(), matrix.rows.begin() + matrix.columnStarts[column],
+                            matrix.rows.begin() + matrix.columnStarts[column + 1]);
+        reduced.columnStarts.push_back(static_cast<uint32_t>(reduced.rows.size()));
+    }
+    return columns;
+}
+
+std::vector<std::set<int>> blockLanczos(const SparseMatrix &matrix, const unsigned threads, const uint64_t seed) {
+    SparseMatrix reduced;
+    std::vector<uint32_t> emptyColumns;
+    const std::vector<uint32_t> columns = removeSingletons(matrix, reduced, emptyColumns);
+
+    std::vector<std::set<int>> result;
+    for(const uint32_t column : emptyColumns) {
+        if(result.size() == 64) return result;
+        result.push_back({static_cast<int>(column)});
+    }
+    if(columns.empty()) return result;
+
+    WorkerPool pool(threads);
+    LanczosMatrix lanczosMatrix(reduced, pool);
+    std::mt19937_64 random(seed);
+
+    for(int attempt = 0; attempt < 4; ++attempt) {
+        auto dependencies = runLanczos(lanczosMatrix, reduced.rowCount, reduced.columnCount(), random);
+        if(dependencies.empty()) {
+            std::cerr << "Block Lanczos failed, restarting" << std::endl;
+            continue;
+        }
+
+        for(const auto &dependency : dependencies) {
+            if(result.size() == 64) break;
+            std::set<int> &original = result.emplace_back();
+            for(const int column : dependency) {
+                original.emplace(static_cast<int>(columns[column]));
+            }
+        }
+        return result;
+    }
+    return result;
+}
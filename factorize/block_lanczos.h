@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+/**
+ * Up to this many relations the dense Gaussian elimination of computeNullSpace is faster than
+ * Block Lanczos.
+ */
+constexpr size_t denseNullSpaceLimit = 2000;
+
+/**
+ * Matrix over GF(2) in compressed sparse column form. Column j holds the rows
+ * rows[columnStarts[j]] to rows[columnStarts[j + 1] - 1].
+ */
+struct SparseMatrix {
+    size_t rowCount = 0;
+    std::vector<uint32_t> columnStarts;
+    std::vector<uint32_t> rows;
+
+    [[nodiscard]] size_t columnCount() const {
+        return columnStarts.size() - 1;
+    }
+};
+
+/**
+ * One column per relation, with a one in the rows of the primes that divide it to an odd power.
+ */
+SparseMatrix buildSparseMatrix(const std::vector<std::vector<int>> &factorizationExponents);
+
+/**
+ * Finds vectors in the null space of matrix with Montgomery's Block Lanczos algorithm ("A Block
+ * Lanczos Algorithm for Finding Dependencies over GF(2)"), working on 64 vectors at once. Only
+ * needs products with the matrix and its transpose, which are split over threads. Lanczos fails
+ * with a small probability, it is then restarted with another random start. Columns that are
+ * all zero come first, each as a dependency of its own.
+ * @return Up to 64 dependencies, in the same form as computeNullSpace
+ */
+std::vector<std::set<int>> blockLanczos(const SparseMatrix &matrix, unsigned threads = 1, uint64_t seed = 1);
@@ -5,10 +5,18 @@
 #include <cmath>
 #include <iostream>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <thread>
+#include <algorithm>
 
 
+#include "fixed_int.h"
+#include "montgomery.h"
+#include "block_lanczos.h"
 #include "poly_generator.h"
+#include "polynomial_scheduler.h"
+#include "relation_collector.h"
 #include "utils.h"
 #include "quadratic_sieve.h"
 
@@ -21,7 +29,7 @@ Number preprocessNumber(const BigInt& num) {
 
     // Check for trivial factors
     for(int i = 0; i < 100; ++i) {
-        while((number.getCurrentValue() % primes1000[i]) == 0) {
+        while(number.getCurrentValue().modSmall(static_cast<long long>(primes1000[i])) == 0) {
             number.addFactor(primes1000[i]);
         }
     }
@@ -31,119 +39,268 @@ Number preprocessNumber(const BigInt& num) {
 }
 
 
-Number pollardRho(Number number) {
-    BigInt x = 2;
-    BigInt y = 2;
+/**
+ * Brent's variant of Pollard's rho with f(x) = x^2 + constant. The differences of a batch of
+ * steps are multiplied before one gcd is taken. x, y and the product are kept in Montgomery
+ * form, which does not change the gcds, since R is coprime to the number.
+ * @return A divisor of the modulus of context, the modulus itself if this constant failed
+ */
+BigInt brentRho(Montgomery<BigInt> &context, const long long constant) {
+    constexpr long long batchSize = 100;
+    const BigInt &value = context.getModulus();
+    const BigInt increment = context.toMontgomery(constant);
+    const auto next = [&context, &increment](const BigInt &x) {
+        return context.add(context.square(x), increment);
+    };
+
+    // x stays at the position of the last power of two, y runs ahead of it
+    BigInt x = context.toMontgomery(2);
+    BigInt y = x;
+    BigInt batchStart = y;
+    BigInt divisor = 1;
+    for(long long length = 1; divisor == 1; length *= 2) {
+        x = y;
+        for(long long i = 0; i < length && divisor == 1; i += batchSize) {
+            batchStart = y;
+            BigInt product = context.one();
+            for(long long j = 0; j < batchSize && i + j < length; ++j) {
+                y = next(y);
+                product = context.multiply(product, context.subtract(x, y));
+            }
+            divisor = BigInt::gcd(product, value);
+        }
+    }
 
-    BigInt d = 1;
+    if(divisor == value) {
+        // The batch went past the factor, repeat it one step at a time
+        y = batchStart;
+        do {
+            y = next(y);
+            divisor = BigInt::gcd(context.subtract(x, y), value);
+        } while(divisor == 1);
+    }
+    return divisor;
+}
 
-    while(d == 1) {
-        x = (x*x + 1) % number.getCurrentValue();
-        y = (y*y + 1) % number.getCurrentValue();
-        y = (y*y + 1) % number.getCurrentValue();
+/**
+ * Splits value into primes, which are added to number
+ * @return false if some composite part could not be split
+ */
+bool addPrimeFactors(Number &number, const BigInt &value) {
+    if(value == 1) return true;
+    if(isProbablePrime(value)) {
+        number.addFactor(value);
+        return true;
+    }
 
-        d = BigInt::gcd(BigInt::abs(x - y), number.getCurrentValue());
+    BigInt divisor = value;
+    if(value.isEven()) {
+        divisor = 2;
+    } else {
+        // Squares of primes would make every gcd either 1 or value
+        const BigInt root = BigInt::sqrt(value);
+        if(root * root == value) {
+            divisor = root;
+        }
     }
 
-    if(d == number.getCurrentValue()) {
-        return number;
+    if(divisor == value) {
+        Montgomery<BigInt> context(value);
+        for(long long constant = 1; constant < 32 && divisor == value; ++constant) {
+            divisor = brentRho(context, constant);
+        }
     }
+    if(divisor == value) return false;
 
-    number.addFactor(d);
-    return number;
+    const bool complete = addPrimeFactors(number, divisor);
+    return addPrimeFactors(number, value / divisor) && complete;
 }
 
+Number pollardRho(Number number) {
+    addPrimeFactors(number, number.getCurrentValue());
+    return number;
+}
 
-void runFactorization(const BigInt &number) {
-    constexpr long long sieveRange = 15000;
 
-    const BigInt logn = BigInt::log2(number);
-    const BigInt exponent = BigInt::sqrt(logn * BigInt::log2(logn)) / BigInt(2);
-    const auto amount = static_cast<long long>(BigInt::exp(2, exponent, 0));
+/**
+ * Sieving stops after this many rounds that only gave trivial factors
+ */
+constexpr int maxSieveRounds = 4;
+
+/**
+ * Runs the quadratic sieve with Int as the integer type for all values modulo number.
+ */
+template<typename Int>
+void runQuadraticSieve(const Int &number, const SieveOptions &options) {
+    // Sieving is blocked, so the interval can grow with the number without leaving the cache
+    const long long sieveRange = std::max<long long>(15000, sieveBlockSize * static_cast<long long>(number.bitLength() / 64));
+
+    const Int logn = Int::log2(number);
+    const Int exponent = Int::sqrt(logn * Int::log2(logn)) / Int(2);
+    const auto amount = static_cast<long long>(Int::exp(2, exponent, 0));
+
+    // The square roots of the number modulo the primes are computed once and shared by all
+    // generators
+    const auto sharedFactorBase = std::make_shared<const FactorBase>(generateFactorBase(amount*2, static_cast<BigInt>(number)));
+    std::vector<Int> factorBase;
+    for(const uint32_t prime : sharedFactorBase->primes) {
+        factorBase.emplace_back(static_cast<long long>(prime));
+    }
 
-    std::vector<BigInt> factorBase = generateFactorBase(amount*2, number);
+    const std::vector<uint8_t> primeLogs = computePrimeLogs(factorBase);
+
+    // Cofactors below the square of the largest prime are prime
+    const auto largestPrime = static_cast<long long>(factorBase.back());
+    const long long largePrimeBound = std::min(largestPrime * options.largePrimeMultiplier, largestPrime * largestPrime);
+    // Cofactors below largePrimeBound * largestPrime have at most two prime factors, both below
+    // largePrimeBound
+    long long doubleLargePrimeBound = 0;
+    if(options.doubleLargePrimes &&
+       __builtin_mul_overflow(largePrimeBound, largestPrime, &doubleLargePrimeBound)) {
+        doubleLargePrimeBound = INT64_MAX;
+    }
 
     std::cout << "Using factor base of size: " << factorBase.size() << std::endl;
 
-    std::set<std::pair<BigInt, BigInt>> equivPairs;
-    while(equivPairs.size() < factorBase.size()) {
-        std::vector<BigInt> basePrimes = selectBasePrimes(number, factorBase, sieveRange);
+    const unsigned threadCount = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Sieving with " << threadCount << " threads" << std::endl;
 
-        std::sort(basePrimes.begin(), basePrimes.end());
-
-        std::cout << "base primes: " << std::endl;
-        for(const auto& prime : basePrimes) {
-            std::cout << "bp: " << prime << std::endl;
-        }
+    // Families are cut into chunks that the threads steal from each other, every thread sieves
+    // with its own copy of the generator and its own buffers. Only the relations meet in the
+    // collector.
+    RelationCollector<Int> collector(number, factorBase.size());
+    PolynomialScheduler<Int> scheduler(threadCount, options.polynomialsPerChunk, [&]() {
+        std::vector<Int> basePrimes = selectBasePrimes(number, factorBase, sieveRange);
 
-        PolyGenerator generator(number, basePrimes, factorBase);
-
-        std::vector<std::pair<BigInt, BigInt>> lastSolutions;
-
-
-        while(generator.hasNext()) {
-            Polynomial polynomial = generator.next();
+        std::sort(basePrimes.begin(), basePrimes.end());
+        collector.printBasePrimes(basePrimes);
+
+        return std::make_shared<const BasicPolyGenerator<Int>>(number, basePrimes, sharedFactorBase);
+    });
+
+    const auto sieveChunks = [&](const size_t worker) {
+        SieveBuffers buffers;
+        std::shared_ptr<const BasicPolyGenerator<Int>> family;
+        std::optional<BasicPolyGenerator<Int>> generator;
+        while(!collector.isDone()) {
+            const PolynomialChunk<Int> chunk = scheduler.next(worker);
+            if(chunk.family != family) {
+                family = chunk.family;
+                generator.emplace(*family);
+            }
+            generator->seek(chunk.begin);
 
-            assert(((polynomial.b*polynomial.b) % polynomial.a) == (number % polynomial.a));
+            PolynomialSolutions solutions;
 
-            std::vector<std::pair<BigInt, BigInt>> solutions = generator.findSolutions(lastSolutions, polynomial);
+            for(long long i = chunk.begin; i < chunk.end && !collector.isDone(); ++i) {
+                BasicPolynomial<Int> polynomial = generator->next();
 
-            auto newEquivPairs = sievePolynomial(polynomial, solutions, factorBase, sieveRange);
-            equivPairs.insert(newEquivPairs.begin(), newEquivPairs.end());
+                assert(((polynomial.b*polynomial.b) % polynomial.a) == (number % polynomial.a));
 
-            std::cout << "found " << equivPairs.size() << " congruences" << std::endl;
+                generator->findSolutions(solutions, polynomial);
 
-            if(equivPairs.size() > factorBase.size()) {
-                std::cout << "found enough congruences, exiting..." << std::endl;
-                break;
+                collector.add(sievePolynomial(polynomial, solutions, factorBase, primeLogs, sieveRange,
+                                              largePrimeBound, doubleLargePrimeBound, buffers));
             }
-
-            lastSolutions = std::move(solutions);
         }
-    }
-
-    if(equivPairs.empty()) {
-        std::cout << "No solutions found" << std::endl;
-        return;
-    }
+    };
+
+    // Every dependency gives a nontrivial factor with probability 1/2 at least, but if all of them
+    // fail, sieving goes on for more relations and with them new dependencies
+    std::vector<Relation<Int>> collected;
+    for(int round = 0; round < maxSieveRounds; ++round) {
+        if(round > 0) {
+            std::cout << "No nontrivial factor yet, collecting more relations" << std::endl;
+            collector.collectMore(relationExcess);
+        }
 
-    std::vector<std::vector<int>> factorizationExponents;
-    std::vector<std::pair<BigInt, BigInt>> equivPairsVector;
-    for(const auto &pair : equivPairs) {
-        factorizationExponents.emplace_back(computeFactors(pair.second, factorBase));
-        equivPairsVector.emplace_back(pair);
-    }
+        std::vector<std::thread> threads;
+        for(unsigned i = 0; i < threadCount; ++i) {
+            threads.emplace_back(sieveChunks, i);
+        }
+        for(auto &thread : threads) {
+            thread.join();
+        }
 
+        std::vector<Relation<Int>> newRelations = collector.takeRelations();
+        collected.insert(collected.end(), std::make_move_iterator(newRelations.begin()),
+                         std::make_move_iterator(newRelations.end()));
 
-    const auto square = computeLinearDependency(factorizationExponents);
+        // Filtering keeps the excess of earlier rounds as well as the new one
+        const std::vector<Relation<Int>> relations = filterRelations(collected, number, factorBase.size(),
+                                                                     (round + 1) * relationExcess);
 
+        if(relations.empty()) {
+            std::cout << "No solutions found" << std::endl;
+            continue;
+        }
 
+        // Primes that are left in no relation are dropped from the matrix
+        std::vector<int> primeIndices(factorBase.size(), -1);
+        std::vector<Int> matrixPrimes;
+        for(const auto &relation : relations) {
+            for(const int index : relation.factors) {
+                if(primeIndices[index] == -1) {
+                    primeIndices[index] = static_cast<int>(matrixPrimes.size());
+                    matrixPrimes.emplace_back(factorBase[index]);
+                }
+            }
+        }
+        std::cout << "Filtering left " << relations.size() << " of " << collected.size() << " relations over "
+                  << matrixPrimes.size() << " primes" << std::endl;
+
+        std::vector<std::vector<int>> factorizationExponents;
+        std::vector<std::pair<Int, Int>> equivPairsVector;
+        for(const auto &relation : relations) {
+            std::vector<int> exponents(matrixPrimes.size());
+            for(const int index : relation.factors) {
+                exponents[primeIndices[index]]++;
+            }
+            factorizationExponents.emplace_back(std::move(exponents));
+            equivPairsVector.emplace_back(relation.x, relation.y);
+        }
 
-    std::cout << "Attempting to find square congruence" << std::endl;
+        // Dense elimination is cubic in the number of relations, larger matrices are solved with
+        // Block Lanczos on the sparse matrix. If Lanczos keeps failing, elimination still works.
+        std::vector<std::set<int>> dependencies;
+        if(relations.size() > denseNullSpaceLimit) {
+            dependencies = blockLanczos(buildSparseMatrix(factorizationExponents), threadCount);
+        }
+        if(dependencies.empty()) {
+            dependencies = computeNullSpace(factorizationExponents);
+        }
+        std::cout << "Found " << dependencies.size() << " linear dependencies" << std::endl;
 
-    auto [first, second] = computeSquareCongruence(square, factorizationExponents,
-                                              factorBase, equivPairsVector);
+        std::cout << "Attempting to find square congruence" << std::endl;
 
-    auto a = first * first;
-    a %= number;
+        // All dependencies are handed over, findSquareFactor stops at the first nontrivial factor
+        const std::optional<Int> factor = findSquareFactor(dependencies, factorizationExponents, matrixPrimes,
+                                                           equivPairsVector, number, threadCount);
+        if(!factor) continue;
 
-    auto b = second * second;
-    b %= number;
+        const Int factor2 = number / *factor;
+        std::cout << "factor1: " << *factor << std::endl;
+        std::cout << "factor2: " << factor2 << std::endl;
 
-    if(a != b) {
-        std::cerr << "squares not equal" << std::endl;
+        if(*factor * factor2 == number) {
+            std::cout << "factors verified" << std::endl;
+        }
+        return;
     }
+    std::cout << "Only trivial factors found" << std::endl;
+}
 
-    BigInt factor = BigInt::gcd(first - second, number);
-    BigInt factor2 = BigInt::gcd(first + second, number);
-
-    std::cout << "factor1: " << factor << std::endl;
-    std::cout << "factor2: " << factor2 << std::endl;
-
-    auto res = number / factor;
-    auto res2 = number / factor2;
-    if(res * factor == number && res2 * factor2 == number) {
-        std::cout << "factors verified" << std::endl;
+void runFactorization(const BigInt &number, const SieveOptions &options) {
+    // Products of two residues modulo number need twice its width, plus some headroom for the
+    // sieve values
+    const size_t bits = 2 * number.bitLength() + 64;
+    if(bits <= 64 * FixedInt<4>::limbCount) {
+        runQuadraticSieve(FixedInt<4>(number), options);
+    } else if(bits <= 64 * FixedInt<8>::limbCount) {
+        runQuadraticSieve(FixedInt<8>(number), options);
+    } else if(bits <= 64 * FixedInt<16>::limbCount) {
+        runQuadraticSieve(FixedInt<16>(number), options);
+    } else {
+        runQuadraticSieve(number, options);
     }
-
-}
\ No newline at end of file
+}
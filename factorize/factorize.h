@@ -3,10 +3,29 @@
 #include "big_int.h"
 
 
-void runFactorization(const BigInt &number);
+/**
+ * Tuning parameters of the quadratic sieve
+ */
+struct SieveOptions {
+    // Partial relations keep a cofactor up to this multiple of the largest factor base prime,
+    // 0 disables them
+    long long largePrimeMultiplier = 64;
+    // Also keep partial relations whose cofactor splits into two large primes
+    bool doubleLargePrimes = true;
+    // Number of sieving threads, 0 uses one per hardware thread
+    unsigned threads = 0;
+    // Polynomials of a family a thread sieves before it looks for work again
+    long long polynomialsPerChunk = 16;
+};
+
+void runFactorization(const BigInt &number, const SieveOptions &options = {});
 
 Number preprocessNumber(const BigInt &num);
 
+/**
+ * Factors the current value of number completely with Pollard's rho method. Only parts that
+ * resist every tried constant are left in the current value.
+ */
 Number pollardRho(Number number);
 
 
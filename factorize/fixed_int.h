@@ -0,0 +1,395 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "big_int.h"
+#include "limb_arithmetic.h"
+#include "montgomery.h"
+
+/**
+ * Signed integer with a magnitude of N limbs, stored inline. Offers the same operations as
+ * BigInt, but never allocates. All results need to fit into N limbs, which is checked in debug
+ * builds only.
+ */
+template<size_t N>
+class FixedInt {
+public:
+    static constexpr size_t limbCount = N;
+
+    FixedInt() = default;
+
+    FixedInt(const long long number) {
+        limbs[0] = number < 0 ? 0 - static_cast<Limb>(number) : static_cast<Limb>(number);
+        positive = number >= 0;
+    }
+
+    explicit FixedInt(const BigInt &number) {
+        assert(number.getLimbs().size() <= N);
+        for(size_t i = 0; i < number.getLimbs().size(); ++i) {
+            limbs[i] = number.getLimbs()[i];
+        }
+        positive = number.isPositive();
+    }
+
+    explicit FixedInt(std::string number) : FixedInt(BigInt(std::move(number))) {}
+
+    static FixedInt fromLimbs(const Limb *limbs, const size_t length, const bool positive = true) {
+        assert(trimmedLength(limbs, length) <= N);
+        FixedInt result;
+        for(size_t i = 0; i < N && i < length; ++i) {
+            result.limbs[i] = limbs[i];
+        }
+        result.positive = positive;
+        result.normalize();
+        return result;
+    }
+
+    explicit operator BigInt() const {
+        return BigInt::fromLimbs(std::vector<Limb>(limbs.begin(), limbs.begin() + length()), positive);
+    }
+
+    bool operator==(const FixedInt &other) const {
+        return positive == other.positive && limbs == other.limbs;
+    }
+
+    bool operator!=(const FixedInt &other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const FixedInt &rhs) const {
+        if(positive != rhs.positive) {
+            return !positive;
+        }
+
+        const int result = compareMagnitude(*this, rhs);
+        return positive ? result == -1 : result == 1;
+    }
+
+    bool operator>(const FixedInt &rhs) const {
+        return rhs < *this;
+    }
+
+    bool operator<=(const FixedInt &rhs) const {
+        return !(*this > rhs);
+    }
+
+    bool operator>=(const FixedInt &rhs) const {
+        return !(*this < rhs);
+    }
+
+    FixedInt& operator++() {
+        *this += FixedInt(1);
+        return *this;
+    }
+
+    FixedInt operator++(int) {
+        FixedInt old = *this;
+        operator++();
+        return old;
+    }
+
+    friend FixedInt operator+(FixedInt lhs, const FixedInt &rhs) {
+        lhs += rhs;
+        return lhs;
+    }
+
+    FixedInt& operator+=(const FixedInt &rhs) {
+        addSigned(rhs, rhs.positive);
+        return *this;
+    }
+
+    friend FixedInt operator-(FixedInt lhs, const FixedInt &rhs) {
+        lhs -= rhs;
+        return lhs;
+    }
+
+    FixedInt& operator-=(const FixedInt &rhs) {
+        addSigned(rhs, !rhs.positive);
+        return *this;
+    }
+
+    friend FixedInt operator*(const FixedInt &lhs, const FixedInt &rhs) {
+        const size_t lhsLength = lhs.length();
+        const size_t rhsLength = rhs.length();
+
+        std::array<Limb, 2 * N> product;
+        multiplyLimbs(product.data(), lhs.limbs.data(), lhsLength, rhs.limbs.data(), rhsLength);
+        assert(trimmedLength(product.data(), lhsLength + rhsLength) <= N);
+
+        FixedInt result;
+        for(size_t i = 0; i < N && i < lhsLength + rhsLength; ++i) {
+            result.limbs[i] = product[i];
+        }
+        result.positive = lhs.positive == rhs.positive;
+        result.normalize();
+        return result;
+    }
+
+    FixedInt& operator*=(const FixedInt &rhs) {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    friend FixedInt operator/(FixedInt lhs, const FixedInt &rhs) {
+        lhs /= rhs;
+        return lhs;
+    }
+
+    FixedInt& operator/=(const FixedInt &rhs) {
+        *this = divmod(*this, rhs).first;
+        return *this;
+    }
+
+    /**
+     * Same semantics as for BigInt: the result is never negative and a modulus of 0 leaves
+     * the number unchanged.
+     */
+    friend FixedInt operator%(const FixedInt &lhs, const FixedInt &rhs) {
+        if(rhs.isZero()) return lhs;
+
+        FixedInt result = divmod(lhs, rhs).second;
+        if(!result.positive) {
+            result += abs(rhs);
+        }
+        return result;
+    }
+
+    FixedInt& operator%=(const FixedInt &rhs) {
+        *this = *this % rhs;
+        return *this;
+    }
+
+    explicit operator long long() const {
+        assert(length() <= 1);
+        assert(limbs[0] <= static_cast<Limb>(INT64_MAX) || (!positive && limbs[0] == static_cast<Limb>(INT64_MAX) + 1));
+        return positive ? static_cast<long long>(limbs[0]) : static_cast<long long>(0 - limbs[0]);
+    }
+
+    /**
+     * Computes *this % divisor for a single limb divisor without building a FixedInt for it.
+     * Like operator%, the result is never negative.
+     */
+    [[nodiscard]] Limb modSmall(const Limb divisor) const {
+        const size_t used = length();
+        if(used <= 1) {
+            return applySign(limbs[0] % divisor, divisor);
+        }
+        return modSmall(LimbDivisor(divisor));
+    }
+
+    [[nodiscard]] Limb modSmall(const LimbDivisor &divisor) const {
+        return applySign(divisor.divide(nullptr, limbs.data(), length()), divisor.divisor);
+    }
+
+    /**
+     * Divides in place by a single limb divisor, rounding towards zero.
+     * @return The remainder of the absolute value
+     */
+    Limb divSmall(const Limb divisor) {
+        const Limb remainder = divideLimb(limbs.data(), limbs.data(), length(), divisor);
+        normalize();
+        return remainder;
+    }
+
+    Limb divSmall(const LimbDivisor &divisor) {
+        const Limb remainder = divisor.divide(limbs.data(), limbs.data(), length());
+        normalize();
+        return remainder;
+    }
+
+    [[nodiscard]] std::string getDigits() const {
+        return static_cast<BigInt>(*this).getDigits();
+    }
+
+    [[nodiscard]] const std::array<Limb, N>& getLimbs() const {
+        return limbs;
+    }
+
+    [[nodiscard]] bool isPositive() const {
+        return positive;
+    }
+
+    [[nodiscard]] bool isEven() const {
+        return (limbs[0] & 1) == 0;
+    }
+
+    [[nodiscard]] bool isZero() const {
+        return length() == 0;
+    }
+
+    [[nodiscard]] size_t bitLength() const {
+        const size_t used = length();
+        if(used == 0) return 0;
+        return 64 * used - __builtin_clzll(limbs[used - 1]);
+    }
+
+    void setSign(const bool sign) {
+        positive = sign;
+        normalize();
+    }
+
+    static FixedInt abs(const FixedInt &num) {
+        FixedInt result = num;
+        result.positive = true;
+        return result;
+    }
+
+    static FixedInt gcd(const FixedInt &lhs, const FixedInt &rhs) {
+        FixedInt result = abs(lhs);
+        FixedInt other = abs(rhs);
+        std::array<Limb, 4 * N + 1> scratch;
+        gcdLimbs(result.limbs.data(), other.limbs.data(), N, scratch.data());
+        return result;
+    }
+
+    static FixedInt sqrt(const FixedInt &num) {
+        if(num.isZero()) return 0;
+
+        // 2^ceil(bits/2) is always larger than the root, so newton's method converges from above
+        const size_t startBit = (num.bitLength() + 1) / 2;
+        FixedInt x;
+        x.limbs[startBit / 64] = Limb(1) << (startBit % 64);
+
+        FixedInt y = (x + num/x) / FixedInt(2);
+        while(y < x) {
+            x = y;
+            y = (x + num/x) / FixedInt(2);
+        }
+        return x;
+    }
+
+    /**
+     * Computes ceil(sqrt(num))
+     */
+    static FixedInt ceilSqrt(const FixedInt &num) {
+        FixedInt res = sqrt(num);
+        if(res*res < num) {
+            ++res;
+        }
+        return res;
+    }
+
+    static FixedInt exp(const FixedInt &base, const FixedInt &exponent, const FixedInt &modulus) {
+        if(exponent <= FixedInt(0)) return 1;
+
+        if(modulus.isPositive() && !modulus.isEven()) {
+            return Montgomery<FixedInt>(modulus).exp(base, exponent);
+        }
+
+        // Even moduli (and 0 for no reduction at all) fall back to square and multiply
+        FixedInt res = 1;
+        for(size_t i = exponent.bitLength(); i-- > 0;) {
+            res *= res;
+            res %= modulus;
+            if((exponent.limbs[i / 64] >> (i % 64)) & 1) {
+                res *= base;
+                res %= modulus;
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Computes floor(log2(num)) from the position of the highest set bit
+     */
+    static FixedInt log2(const FixedInt &num) {
+        assert(num > 0);
+        return static_cast<long long>(num.bitLength() - 1);
+    }
+
+    /**
+     * @return 0 if num has no inverse
+     */
+    static FixedInt modInverse(const FixedInt &num, const FixedInt &mod) {
+        assert(!num.isZero() && mod > 0);
+        FixedInt reduced = num % mod;
+        FixedInt modulus = mod;
+        FixedInt result;
+        std::array<Limb, 6 * N + 1> scratch;
+        if(!modInverseLimbs(result.limbs.data(), reduced.limbs.data(), modulus.limbs.data(), N, scratch.data())) {
+            return 0;
+        }
+        return result;
+    }
+
+    /**
+     * Truncating division. Returns the quotient and the remainder lhs - quotient*rhs, which has
+     * the sign of lhs (unlike operator%, which is never negative).
+     */
+    static std::pair<FixedInt, FixedInt> divmod(const FixedInt &lhs, const FixedInt &rhs) {
+        assert(!rhs.isZero());
+        const size_t lhsLength = lhs.length();
+        const size_t rhsLength = rhs.length();
+
+        std::pair<FixedInt, FixedInt> result;
+        std::array<Limb, 2 * N + 1> scratch;
+        divideLimbs(result.first.limbs.data(), result.second.limbs.data(), lhs.limbs.data(), lhsLength,
+                    rhs.limbs.data(), rhsLength, scratch.data());
+        result.first.positive = lhs.positive == rhs.positive;
+        result.first.normalize();
+        result.second.positive = lhs.positive;
+        result.second.normalize();
+        return result;
+    }
+
+    static int compareMagnitude(const FixedInt &lhs, const FixedInt &rhs) {
+        return compareLimbs(lhs.limbs.data(), N, rhs.limbs.data(), N);
+    }
+
+private:
+    std::array<Limb, N> limbs{};
+    bool positive = true;
+
+    [[nodiscard]] size_t length() const {
+        return trimmedLength(limbs.data(), N);
+    }
+
+    /**
+     * Turns the remainder of the absolute value into the remainder operator% would return
+     */
+    [[nodiscard]] Limb applySign(const Limb remainder, const Limb divisor) const {
+        return (positive || remainder == 0) ? remainder : divisor - remainder;
+    }
+
+    void normalize() {
+        if(isZero()) {
+            // There is no negative zero
+            positive = true;
+        }
+    }
+
+    /**
+     * this += rhs, with the sign of rhs replaced by rhsPositive
+     */
+    void addSigned(const FixedInt &rhs, const bool rhsPositive) {
+        if(positive == rhsPositive) {
+            [[maybe_unused]] const Limb carry = addLimbs(limbs.data(), limbs.data(), N, rhs.limbs.data(), N);
+            assert(carry == 0);
+            return;
+        }
+
+        // Signs differ, so the smaller magnitude is subtracted from the larger one
+        if(compareMagnitude(*this, rhs) >= 0) {
+            subtractLimbs(limbs.data(), limbs.data(), N, rhs.limbs.data(), N);
+        } else {
+            subtractLimbs(limbs.data(), rhs.limbs.data(), N, limbs.data(), N);
+            positive = rhsPositive;
+        }
+        normalize();
+    }
+};
+
+template<size_t N>
+std::ostream &operator<<(std::ostream &os, const FixedInt<N> &obj) {
+    return os << static_cast<BigInt>(obj);
+}
+
+/*
+ * Integer types the sieve pipeline is instantiated for. runFactorization picks the smallest
+ * FixedInt that can hold products of two residues and falls back to BigInt above that.
+ */
+#define FOR_EACH_SIEVE_INT(X) X(BigInt) X(FixedInt<4>) X(FixedInt<8>) X(FixedInt<16>)
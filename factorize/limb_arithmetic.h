@@ -0,0 +1,564 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Arithmetic kernels on little endian arrays of 64-bit limbs. They are shared by BigInt, which
+ * keeps its limbs on the heap, and FixedInt, which keeps them inline. None of them allocate.
+ */
+
+using Limb = uint64_t;
+using DoubleLimb = unsigned __int128;
+
+
+inline size_t trimmedLength(const Limb *limbs, size_t length) {
+    while(length > 0 && limbs[length - 1] == 0) {
+        --length;
+    }
+    return length;
+}
+
+/**
+ * Compares the magnitudes of two limb arrays. Leading zero limbs are ignored.
+ * @return -1 if lhs < rhs
+ *          0 if lhs == rhs
+ *          1 if lhs > rhs
+ */
+inline int compareLimbs(const Limb *lhs, size_t lhsLength, const Limb *rhs, size_t rhsLength) {
+    lhsLength = trimmedLength(lhs, lhsLength);
+    rhsLength = trimmedLength(rhs, rhsLength);
+    if(lhsLength != rhsLength) {
+        return lhsLength < rhsLength ? -1 : 1;
+    }
+
+    for(size_t i = lhsLength; i-- > 0;) {
+        if(lhs[i] != rhs[i]) {
+            return lhs[i] < rhs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * result = lhs + rhs. Assumes lhsLength >= rhsLength, result has room for lhsLength limbs
+ * and may alias lhs.
+ * @return The carry out of the highest limb
+ */
+inline Limb addLimbs(Limb *result, const Limb *lhs, const size_t lhsLength,
+                     const Limb *rhs, const size_t rhsLength) {
+    assert(lhsLength >= rhsLength);
+
+    Limb carry = 0;
+    size_t i = 0;
+    for(; i < rhsLength; ++i) {
+        const DoubleLimb sum = static_cast<DoubleLimb>(lhs[i]) + rhs[i] + carry;
+        result[i] = static_cast<Limb>(sum);
+        carry = static_cast<Limb>(sum >> 64);
+    }
+    for(; i < lhsLength; ++i) {
+        result[i] = lhs[i] + carry;
+        carry = (carry != 0 && result[i] == 0) ? 1 : 0;
+    }
+    return carry;
+}
+
+/**
+ * result = lhs - rhs. Assumes lhsLength >= rhsLength, result has room for lhsLength limbs
+ * and may alias lhs.
+ * @return The borrow out of the highest limb, 1 if rhs > lhs
+ */
+inline Limb subtractLimbs(Limb *result, const Limb *lhs, const size_t lhsLength,
+                          const Limb *rhs, const size_t rhsLength) {
+    assert(lhsLength >= rhsLength);
+
+    Limb borrow = 0;
+    size_t i = 0;
+    for(; i < rhsLength; ++i) {
+        const DoubleLimb difference = static_cast<DoubleLimb>(lhs[i]) - rhs[i] - borrow;
+        result[i] = static_cast<Limb>(difference);
+        borrow = static_cast<Limb>(difference >> 64) & 1;
+    }
+    for(; i < lhsLength; ++i) {
+        const Limb left = lhs[i];
+        result[i] = left - borrow;
+        borrow = (borrow != 0 && left == 0) ? 1 : 0;
+    }
+    return borrow;
+}
+
+/**
+ * limbs = limbs * factor + summand
+ * @return The limb carried out of the highest position
+ */
+inline Limb multiplyAddLimb(Limb *limbs, const size_t length, const Limb factor, const Limb summand) {
+    Limb carry = summand;
+    for(size_t i = 0; i < length; ++i) {
+        const DoubleLimb product = static_cast<DoubleLimb>(limbs[i]) * factor + carry;
+        limbs[i] = static_cast<Limb>(product);
+        carry = static_cast<Limb>(product >> 64);
+    }
+    return carry;
+}
+
+/**
+ * Divisor of a single limb with a precomputed reciprocal, so that every division step needs two
+ * multiplications instead of a 128 by 64 bit division (Möller and Granlund, "Improved division by
+ * invariant integers"). Worth it as soon as the same divisor is used for more than one limb.
+ */
+struct LimbDivisor {
+    Limb divisor;
+    // divisor shifted, so that its highest bit is set
+    Limb normalized;
+    // floor((2^128 - 1) / normalized) - 2^64
+    Limb reciprocal;
+    int shift;
+
+    explicit LimbDivisor(const Limb divisor) : divisor(divisor) {
+        assert(divisor != 0);
+        shift = __builtin_clzll(divisor);
+        normalized = divisor << shift;
+        reciprocal = static_cast<Limb>(((static_cast<DoubleLimb>(~normalized) << 64) | ~Limb(0)) / normalized);
+    }
+
+    /**
+     * Divides high * 2^64 + low by normalized. Assumes high < normalized.
+     * @return The quotient, the remainder is written to remainder
+     */
+    Limb divideNormalized(const Limb high, const Limb low, Limb &remainder) const {
+        const DoubleLimb estimate = static_cast<DoubleLimb>(reciprocal) * high +
+                                    ((static_cast<DoubleLimb>(high) << 64) | low);
+        Limb quotient = static_cast<Limb>(estimate >> 64) + 1;
+        Limb rest = low - quotient * normalized;
+        if(rest > static_cast<Limb>(estimate)) {
+            --quotient;
+            rest += normalized;
+        }
+        if(rest >= normalized) {
+            ++quotient;
+            rest -= normalized;
+        }
+        remainder = rest;
+        return quotient;
+    }
+
+    /**
+     * quotient = limbs / divisor. quotient has room for length limbs and may alias limbs.
+     * quotient may be nullptr, if only the remainder is needed.
+     * @return The remainder of the division
+     */
+    Limb divide(Limb *quotient, const Limb *limbs, const size_t length) const {
+        if(length == 0) return 0;
+
+        // Divide limbs * 2^shift by the normalized divisor, the remainder is shifted back at the end
+        Limb remainder = shift == 0 ? 0 : limbs[length - 1] >> (64 - shift);
+        for(size_t i = length; i-- > 0;) {
+            Limb low = limbs[i] << shift;
+            if(shift != 0 && i > 0) {
+                low |= limbs[i - 1] >> (64 - shift);
+            }
+            const Limb digit = divideNormalized(remainder, low, remainder);
+            if(quotient != nullptr) quotient[i] = digit;
+        }
+        return remainder >> shift;
+    }
+};
+
+/**
+ * quotient = limbs / divisor. quotient has room for length limbs and may alias limbs.
+ * @return The remainder of the division
+ */
+inline Limb divideLimb(Limb *quotient, const Limb *limbs, const size_t length, const Limb divisor) {
+    assert(divisor != 0);
+    if(length <= 1) {
+        const Limb value = length == 0 ? 0 : limbs[0];
+        if(length == 1) quotient[0] = value / divisor;
+        return value % divisor;
+    }
+    return LimbDivisor(divisor).divide(quotient, limbs, length);
+}
+
+/**
+ * result = lhs * rhs. result needs room for lhsLength + rhsLength limbs and must not alias
+ * one of the factors.
+ */
+inline void multiplyLimbs(Limb *result, const Limb *lhs, const size_t lhsLength,
+                          const Limb *rhs, const size_t rhsLength) {
+    for(size_t i = 0; i < lhsLength + rhsLength; ++i) {
+        result[i] = 0;
+    }
+
+    for(size_t i = 0; i < lhsLength; ++i) {
+        Limb carry = 0;
+        for(size_t j = 0; j < rhsLength; ++j) {
+            const DoubleLimb product = static_cast<DoubleLimb>(lhs[i]) * rhs[j] + result[i + j] + carry;
+            result[i + j] = static_cast<Limb>(product);
+            carry = static_cast<Limb>(product >> 64);
+        }
+        result[i + rhsLength] = carry;
+    }
+}
+
+/**
+ * Computes quotient = lhs / rhs and remainder = lhs % rhs with Knuth's algorithm D (TAOCP 4.3.1).
+ * quotient needs room for lhsLength limbs, remainder for rhsLength limbs and scratch for
+ * lhsLength + rhsLength + 1 limbs. Single limb divisors take a fast path that does not touch
+ * scratch. None of the buffers may alias one of the operands. rhs must not be zero.
+ */
+inline void divideLimbs(Limb *quotient, Limb *remainder, const Limb *lhs, size_t lhsLength,
+                        const Limb *rhs, size_t rhsLength, Limb *scratch) {
+    const size_t quotientLength = lhsLength;
+    const size_t remainderLength = rhsLength;
+    for(size_t i = 0; i < quotientLength; ++i) quotient[i] = 0;
+    for(size_t i = 0; i < remainderLength; ++i) remainder[i] = 0;
+
+    lhsLength = trimmedLength(lhs, lhsLength);
+    rhsLength = trimmedLength(rhs, rhsLength);
+    assert(rhsLength > 0);
+
+    if(lhsLength < rhsLength) {
+        for(size_t i = 0; i < lhsLength; ++i) remainder[i] = lhs[i];
+        return;
+    }
+
+    if(rhsLength == 1) {
+        remainder[0] = divideLimb(quotient, lhs, lhsLength, rhs[0]);
+        return;
+    }
+
+    // Normalize, so that the highest bit of the divisor is set. This keeps the estimate for
+    // every quotient limb at most two too large.
+    const int shift = __builtin_clzll(rhs[rhsLength - 1]);
+    Limb *dividend = scratch;
+    Limb *divisor = scratch + lhsLength + 1;
+    for(size_t i = rhsLength; i-- > 1;) {
+        divisor[i] = shift == 0 ? rhs[i] : (rhs[i] << shift) | (rhs[i - 1] >> (64 - shift));
+    }
+    divisor[0] = rhs[0] << shift;
+    dividend[lhsLength] = shift == 0 ? 0 : lhs[lhsLength - 1] >> (64 - shift);
+    for(size_t i = lhsLength; i-- > 1;) {
+        dividend[i] = shift == 0 ? lhs[i] : (lhs[i] << shift) | (lhs[i - 1] >> (64 - shift));
+    }
+    dividend[0] = lhs[0] << shift;
+
+    const Limb high = divisor[rhsLength - 1];
+    const Limb second = divisor[rhsLength - 2];
+    for(size_t j = lhsLength - rhsLength + 1; j-- > 0;) {
+        // Estimate the quotient limb from the two highest limbs and correct it with the third
+        const DoubleLimb top = (static_cast<DoubleLimb>(dividend[j + rhsLength]) << 64) | dividend[j + rhsLength - 1];
+        DoubleLimb estimate = top / high;
+        DoubleLimb estimateRemainder = top % high;
+        while(estimate >> 64 != 0 || estimate * second >
+              ((estimateRemainder << 64) | dividend[j + rhsLength - 2])) {
+            --estimate;
+            estimateRemainder += high;
+            if(estimateRemainder >> 64 != 0) break;
+        }
+
+        // dividend -= estimate * divisor << (64 * j)
+        const Limb digit = static_cast<Limb>(estimate);
+        Limb carry = 0;
+        Limb borrow = 0;
+        for(size_t i = 0; i < rhsLength; ++i) {
+            const DoubleLimb product = static_cast<DoubleLimb>(digit) * divisor[i] + carry;
+            carry = static_cast<Limb>(product >> 64);
+            const DoubleLimb difference = static_cast<DoubleLimb>(dividend[i + j]) - static_cast<Limb>(product) - borrow;
+            dividend[i + j] = static_cast<Limb>(difference);
+            borrow = static_cast<Limb>(difference >> 64) & 1;
+        }
+        const DoubleLimb difference = static_cast<DoubleLimb>(dividend[j + rhsLength]) - carry - borrow;
+        dividend[j + rhsLength] = static_cast<Limb>(difference);
+
+        quotient[j] = digit;
+        if((difference >> 64) != 0) {
+            // The estimate was one too large, add the divisor back
+            quotient[j]--;
+            const Limb addCarry = addLimbs(dividend + j, dividend + j, rhsLength, divisor, rhsLength);
+            dividend[j + rhsLength] += addCarry;
+        }
+    }
+
+    for(size_t i = 0; i < rhsLength; ++i) {
+        remainder[i] = shift == 0 ? dividend[i] : (dividend[i] >> shift) | (dividend[i + 1] << (64 - shift));
+    }
+}
+
+/**
+ * Greatest common divisor of two limbs with Stein's binary algorithm, which needs no division
+ */
+inline Limb binaryGcd(Limb u, Limb v) {
+    if(u == 0) return v;
+    if(v == 0) return u;
+
+    const int shift = __builtin_ctzll(u | v);
+    u >>= __builtin_ctzll(u);
+    while(v != 0) {
+        v >>= __builtin_ctzll(v);
+        if(u > v) std::swap(u, v);
+        v -= u;
+    }
+    return u << shift;
+}
+
+/**
+ * result = x * xFactor - y * yFactor over length limbs. The result must not be negative. result
+ * may alias x or y.
+ */
+inline void multiplySubtractLimbs(Limb *result, const Limb *x, const Limb xFactor,
+                                  const Limb *y, const Limb yFactor, const size_t length) {
+    Limb xCarry = 0;
+    Limb yCarry = 0;
+    Limb borrow = 0;
+    for(size_t i = 0; i < length; ++i) {
+        const DoubleLimb xProduct = static_cast<DoubleLimb>(x[i]) * xFactor + xCarry;
+        const DoubleLimb yProduct = static_cast<DoubleLimb>(y[i]) * yFactor + yCarry;
+        xCarry = static_cast<Limb>(xProduct >> 64);
+        yCarry = static_cast<Limb>(yProduct >> 64);
+        const DoubleLimb difference = static_cast<DoubleLimb>(static_cast<Limb>(xProduct)) - static_cast<Limb>(yProduct) - borrow;
+        result[i] = static_cast<Limb>(difference);
+        borrow = static_cast<Limb>(difference >> 64) & 1;
+    }
+    assert(xCarry == yCarry + borrow);
+}
+
+/**
+ * result = x * xFactor + y * yFactor over length limbs. result may alias x or y.
+ * @return The carry out of the highest limb
+ */
+inline Limb multiplyAddLimbs(Limb *result, const Limb *x, const Limb xFactor,
+                             const Limb *y, const Limb yFactor, const size_t length) {
+    Limb xCarry = 0;
+    Limb yCarry = 0;
+    Limb carry = 0;
+    for(size_t i = 0; i < length; ++i) {
+        const DoubleLimb xProduct = static_cast<DoubleLimb>(x[i]) * xFactor + xCarry;
+        const DoubleLimb yProduct = static_cast<DoubleLimb>(y[i]) * yFactor + yCarry;
+        xCarry = static_cast<Limb>(xProduct >> 64);
+        yCarry = static_cast<Limb>(yProduct >> 64);
+        const DoubleLimb sum = static_cast<DoubleLimb>(static_cast<Limb>(xProduct)) + static_cast<Limb>(yProduct) + carry;
+        result[i] = static_cast<Limb>(sum);
+        carry = static_cast<Limb>(sum >> 64);
+    }
+    return xCarry + yCarry + carry;
+}
+
+/**
+ * Steps of the Euclidean algorithm on two numbers u > v, collected in one matrix: after them the
+ * remainders are (a*u + b*v, c*u + d*v). a and b have opposite signs, so do c and d.
+ */
+struct LehmerCosequence {
+    long long a = 1, b = 0, c = 0, d = 1;
+    int steps = 0;
+};
+
+/**
+ * The 60 bits of a number from bit shift on
+ */
+inline long long leadingBits(const Limb *limbs, const size_t length, const size_t shift) {
+    const size_t index = shift / 64;
+    const size_t offset = shift % 64;
+    if(index >= length) return 0;
+    Limb bits = limbs[index] >> offset;
+    if(offset != 0 && index + 1 < length) {
+        bits |= limbs[index + 1] << (64 - offset);
+    }
+    return static_cast<long long>(bits & ((Limb(1) << 60) - 1));
+}
+
+/**
+ * Runs the Euclidean algorithm on the leading 60 bits of u > v, as long as the quotients are
+ * certainly those of u and v themselves (Lehmer, TAOCP 4.5.2 Algorithm L). All of them are then
+ * applied at once, with multiplications by single limbs instead of a division each. u needs at
+ * least two limbs.
+ */
+inline LehmerCosequence lehmerCosequence(const Limb *u, const size_t uLength, const Limb *v, const size_t vLength) {
+    const size_t shift = 64 * uLength - __builtin_clzll(u[uLength - 1]) - 60;
+    long long x = leadingBits(u, uLength, shift);
+    long long y = leadingBits(v, vLength, shift);
+
+    LehmerCosequence cosequence;
+    auto &[a, b, c, d, steps] = cosequence;
+    while(y + c != 0 && y + d != 0) {
+        const long long quotient = (x + a) / (y + c);
+        if(quotient != (x + b) / (y + d)) break;
+
+        long long next = a - quotient * c;
+        a = c;
+        c = next;
+        next = b - quotient * d;
+        b = d;
+        d = next;
+        next = x - quotient * y;
+        x = y;
+        y = next;
+        ++steps;
+    }
+    return cosequence;
+}
+
+/**
+ * result = uFactor * u + vFactor * v over length limbs, for factors of opposite sign and a
+ * result that is not negative
+ */
+inline void combineLimbs(Limb *result, const Limb *u, const long long uFactor,
+                         const Limb *v, const long long vFactor, const size_t length) {
+    if(vFactor <= 0) {
+        multiplySubtractLimbs(result, u, static_cast<Limb>(uFactor), v, static_cast<Limb>(-vFactor), length);
+    } else {
+        assert(uFactor <= 0);
+        multiplySubtractLimbs(result, v, static_cast<Limb>(vFactor), u, static_cast<Limb>(-uFactor), length);
+    }
+}
+
+/**
+ * Greatest common divisor with Lehmer's algorithm, finished with binaryGcd once the smaller
+ * number fits into a single limb. lhs and rhs hold length limbs each and are overwritten.
+ * scratch needs room for 4 * length + 1 limbs.
+ * @return The length of the gcd, which is written to lhs
+ */
+inline size_t gcdLimbs(Limb *lhs, Limb *rhs, const size_t length, Limb *scratch) {
+    Limb *u = lhs;
+    Limb *v = rhs;
+    size_t uLength = trimmedLength(u, length);
+    size_t vLength = trimmedLength(v, length);
+    if(compareLimbs(u, uLength, v, vLength) < 0) {
+        std::swap(u, v);
+        std::swap(uLength, vLength);
+    }
+
+    // Both buffers stay zero above their lengths
+    while(vLength > 1) {
+        const LehmerCosequence cosequence = lehmerCosequence(u, uLength, v, vLength);
+        if(cosequence.steps > 0) {
+            combineLimbs(scratch, u, cosequence.a, v, cosequence.b, uLength);
+            combineLimbs(scratch + uLength, u, cosequence.c, v, cosequence.d, uLength);
+            for(size_t i = 0; i < uLength; ++i) {
+                u[i] = scratch[i];
+                v[i] = scratch[uLength + i];
+            }
+            vLength = trimmedLength(v, uLength);
+            uLength = trimmedLength(u, uLength);
+        } else {
+            // The leading bits do not even determine the first quotient, divide once
+            Limb *quotient = scratch;
+            Limb *remainder = scratch + uLength;
+            divideLimbs(quotient, remainder, u, uLength, v, vLength, remainder + vLength);
+            for(size_t i = 0; i < uLength; ++i) {
+                u[i] = i < vLength ? remainder[i] : 0;
+            }
+            std::swap(u, v);
+            uLength = vLength;
+            vLength = trimmedLength(v, uLength);
+        }
+        assert(compareLimbs(u, uLength, v, vLength) > 0);
+    }
+
+    if(vLength == 0) {
+        if(u != lhs) {
+            for(size_t i = 0; i < uLength; ++i) lhs[i] = u[i];
+        }
+        return uLength;
+    }
+
+    const Limb remainder = uLength == 1 ? u[0] % v[0] : LimbDivisor(v[0]).divide(nullptr, u, uLength);
+    const Limb gcd = binaryGcd(v[0], remainder);
+    for(size_t i = 0; i < length; ++i) lhs[i] = 0;
+    lhs[0] = gcd;
+    return 1;
+}
+
+/**
+ * Inverse of num modulo mod with the extended version of Lehmer's algorithm. Only the cofactors
+ * t_k of num are tracked, remainder r_k = t_k * num (mod mod). Their signs alternate, so the
+ * magnitudes only ever get added. num < mod, both hold length limbs and are overwritten. result
+ * gets length limbs, scratch needs room for 6 * length + 1 limbs.
+ * @return false if num has no inverse
+ */
+inline bool modInverseLimbs(Limb *result, Limb *num, Limb *mod, const size_t length, Limb *scratch) {
+    for(size_t i = 0; i < length; ++i) result[i] = mod[i];
+    assert(compareLimbs(num, length, mod, length) < 0);
+
+    Limb *r0 = mod;
+    Limb *r1 = num;
+    Limb *t0 = scratch;
+    Limb *t1 = scratch + length;
+    Limb *work = scratch + 2 * length;
+    for(size_t i = 0; i < length; ++i) {
+        t0[i] = 0;
+        t1[i] = 0;
+    }
+    if(length > 0) t1[0] = 1;
+    // t0 has the opposite sign
+    bool t1Negative = false;
+
+    size_t r0Length = trimmedLength(r0, length);
+    size_t r1Length = trimmedLength(r1, length);
+    while(r1Length > 0) {
+        LehmerCosequence cosequence;
+        if(r1Length > 1) {
+            cosequence = lehmerCosequence(r0, r0Length, r1, r1Length);
+        }
+
+        if(cosequence.steps > 0) {
+            const auto magnitude = [](const long long factor) {
+                return static_cast<Limb>(factor < 0 ? -factor : factor);
+            };
+            combineLimbs(work, r0, cosequence.a, r1, cosequence.b, r0Length);
+            combineLimbs(work + r0Length, r0, cosequence.c, r1, cosequence.d, r0Length);
+            for(size_t i = 0; i < r0Length; ++i) {
+                r0[i] = work[i];
+                r1[i] = work[r0Length + i];
+            }
+            [[maybe_unused]] const Limb carry0 = multiplyAddLimbs(work, t0, magnitude(cosequence.a), t1, magnitude(cosequence.b), length);
+            [[maybe_unused]] const Limb carry1 = multiplyAddLimbs(work + length, t0, magnitude(cosequence.c), t1, magnitude(cosequence.d), length);
+            assert(carry0 == 0 && carry1 == 0);
+            for(size_t i = 0; i < length; ++i) {
+                t0[i] = work[i];
+                t1[i] = work[length + i];
+            }
+            t1Negative ^= (cosequence.steps & 1) != 0;
+            r1Length = trimmedLength(r1, r0Length);
+            r0Length = trimmedLength(r0, r0Length);
+            continue;
+        }
+
+        // One division step: (r0, r1) = (r1, r0 - q*r1) and (t0, t1) = (t1, t0 - q*t1)
+        Limb *quotient = work;
+        Limb *remainder = quotient + length;
+        Limb *product = remainder + length;
+        divideLimbs(quotient, remainder, r0, r0Length, r1, r1Length, product);
+        const size_t quotientLength = trimmedLength(quotient, r0Length);
+        const size_t t1Length = trimmedLength(t1, length);
+        multiplyLimbs(product, quotient, quotientLength, t1, t1Length);
+        for(size_t i = quotientLength + t1Length; i < length; ++i) product[i] = 0;
+        assert(trimmedLength(product, quotientLength + t1Length) <= length);
+        [[maybe_unused]] const Limb carry = addLimbs(product, product, length, t0, length);
+        assert(carry == 0);
+        for(size_t i = 0; i < length; ++i) {
+            t0[i] = t1[i];
+            t1[i] = product[i];
+        }
+        t1Negative = !t1Negative;
+
+        for(size_t i = 0; i < r0Length; ++i) {
+            r0[i] = i < r1Length ? remainder[i] : 0;
+        }
+        std::swap(r0, r1);
+        r0Length = r1Length;
+        r1Length = trimmedLength(r1, r0Length);
+    }
+
+    if(r0Length != 1 || r0[0] != 1) return false;
+
+    // r0 = t0 * num, with t0 negative exactly if t1 is not
+    if(t1Negative) {
+        for(size_t i = 0; i < length; ++i) result[i] = t0[i];
+    } else if(trimmedLength(t0, length) != 0) {
+        subtractLimbs(result, result, length, t0, length);
+    } else {
+        for(size_t i = 0; i < length; ++i) result[i] = 0;
+    }
+    return true;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "limb_arithmetic.h"
+
+/**
+ * Precomputed context for Montgomery arithmetic modulo one odd number. Values in Montgomery form
+ * are x*R mod modulus with R = 2^(64*n), where n is the number of limbs of the modulus.
+ * Multiplications in that form need no division, only a reduction by R.
+ *
+ * Int can be BigInt or FixedInt. All buffers are allocated once in the constructor, so a context
+ * should be reused for as many operations as possible. It is not safe to share one context
+ * between threads.
+ */
+template<typename Int>
+class Montgomery {
+public:
+
+    explicit Montgomery(const Int &modulus) : modulus(modulus) {
+        assert(modulus.isPositive() && !modulus.isEven());
+
+        length = trimmedLength(modulus.getLimbs().data(), modulus.getLimbs().size());
+        modulusLimbs.assign(modulus.getLimbs().begin(), modulus.getLimbs().begin() + length);
+        product.resize(length + 2);
+        lhsLimbs.resize(length);
+        rhsLimbs.resize(length);
+        resultLimbs.resize(length);
+
+        // Newton iteration for modulus^-1 mod 2^64, every step doubles the number of correct bits
+        Limb inverse = modulusLimbs[0];
+        for(int i = 0; i < 5; ++i) {
+            inverse *= 2 - modulusLimbs[0] * inverse;
+        }
+        negativeInverse = 0 - inverse;
+
+        // R mod modulus and R^2 mod modulus by repeated doubling
+        oneLimbs.assign(length, 0);
+        oneLimbs[0] = 1;
+        for(size_t i = 0; i < 64 * length; ++i) {
+            doubleMod(oneLimbs.data());
+        }
+        rSquaredLimbs = oneLimbs;
+        for(size_t i = 0; i < 64 * length; ++i) {
+            doubleMod(rSquaredLimbs.data());
+        }
+    }
+
+    [[nodiscard]] const Int& getModulus() const {
+        return modulus;
+    }
+
+    /**
+     * @return 1 in Montgomery form
+     */
+    [[nodiscard]] Int one() const {
+        return Int::fromLimbs(oneLimbs.data(), length);
+    }
+
+    Int toMontgomery(const Int &num) {
+        load(lhsLimbs.data(), num);
+        multiplyInto(resultLimbs.data(), lhsLimbs.data(), rSquaredLimbs.data());
+        return Int::fromLimbs(resultLimbs.data(), length);
+    }
+
+    Int fromMontgomery(const Int &num) {
+        load(lhsLimbs.data(), num);
+        std::fill(rhsLimbs.begin(), rhsLimbs.end(), 0);
+        rhsLimbs[0] = 1;
+        multiplyInto(resultLimbs.data(), lhsLimbs.data(), rhsLimbs.data());
+        return Int::fromLimbs(resultLimbs.data(), length);
+    }
+
+    /**
+     * Multiplies two numbers in Montgomery form.
+     */
+    Int multiply(const Int &lhs, const Int &rhs) {
+        load(lhsLimbs.data(), lhs);
+        load(rhsLimbs.data(), rhs);
+        multiplyInto(resultLimbs.data(), lhsLimbs.data(), rhsLimbs.data());
+        return Int::fromLimbs(resultLimbs.data(), length);
+    }
+
+    Int square(const Int &num) {
+        return multiply(num, num);
+    }
+
+    /**
+     * Adds two numbers in Montgomery form (or two ordinary residues).
+     */
+    Int add(const Int &lhs, const Int &rhs) const {
+        Int result = lhs + rhs;
+        if(result >= modulus) {
+            result -= modulus;
+        }
+        return result;
+    }
+
+    /**
+     * Subtracts two numbers in Montgomery form (or two ordinary residues).
+     */
+    Int subtract(const Int &lhs, const Int &rhs) const {
+        Int result = lhs - rhs;
+        if(result < Int(0)) {
+            result += modulus;
+        }
+        return result;
+    }
+
+    /**
+     * Computes lhs * rhs mod modulus for two ordinary residues.
+     */
+    Int multiplyMod(const Int &lhs, const Int &rhs) {
+        // (lhs*rhs/R) * R^2 / R = lhs*rhs
+        load(lhsLimbs.data(), lhs);
+        load(rhsLimbs.data(), rhs);
+        multiplyInto(resultLimbs.data(), lhsLimbs.data(), rhsLimbs.data());
+        multiplyInto(resultLimbs.data(), resultLimbs.data(), rSquaredLimbs.data());
+        return Int::fromLimbs(resultLimbs.data(), length);
+    }
+
+    /**
+     * Computes base^exponent mod modulus with left to right sliding window exponentiation.
+     * base is an ordinary residue (it is reduced if necessary), so is the result.
+     */
+    Int exp(const Int &base, const Int &exponent) {
+        if(exponent <= Int(0)) return Int(1) % modulus;
+
+        const size_t bits = exponent.bitLength();
+        const size_t windowSize = bits > 512 ? 5 : bits > 128 ? 4 : bits > 24 ? 3 : 2;
+        const size_t tableSize = size_t(1) << (windowSize - 1);
+        table.resize(tableSize * length);
+
+        // table[k] = base^(2k+1) in Montgomery form
+        load(lhsLimbs.data(), base);
+        multiplyInto(table.data(), lhsLimbs.data(), rSquaredLimbs.data());
+        multiplyInto(rhsLimbs.data(), table.data(), table.data());
+        for(size_t k = 1; k < tableSize; ++k) {
+            multiplyInto(table.data() + k * length, table.data() + (k - 1) * length, rhsLimbs.data());
+        }
+
+        const auto &exponentLimbs = exponent.getLimbs();
+        const auto bit = [&exponentLimbs](const size_t index) {
+            return (exponentLimbs[index / 64] >> (index % 64)) & 1;
+        };
+
+        std::copy(oneLimbs.begin(), oneLimbs.end(), resultLimbs.begin());
+        bool started = false;
+        size_t i = bits;
+        while(i > 0) {
+            if(!bit(i - 1)) {
+                if(started) multiplyInto(resultLimbs.data(), resultLimbs.data(), resultLimbs.data());
+                --i;
+                continue;
+            }
+
+            // Longest window of at most windowSize bits starting at i - 1 that ends with a set bit
+            size_t windowEnd = i > windowSize ? i - windowSize : 0;
+            while(!bit(windowEnd)) {
+                ++windowEnd;
+            }
+
+            size_t window = 0;
+            for(size_t j = i; j-- > windowEnd;) {
+                window = (window << 1) | bit(j);
+                if(started) multiplyInto(resultLimbs.data(), resultLimbs.data(), resultLimbs.data());
+            }
+
+            multiplyInto(resultLimbs.data(), resultLimbs.data(), table.data() + (window >> 1) * length);
+            started = true;
+            i = windowEnd;
+        }
+
+        std::fill(rhsLimbs.begin(), rhsLimbs.end(), 0);
+        rhsLimbs[0] = 1;
+        multiplyInto(resultLimbs.data(), resultLimbs.data(), rhsLimbs.data());
+        return Int::fromLimbs(resultLimbs.data(), length);
+    }
+
+private:
+    Int modulus;
+    size_t length;
+    Limb negativeInverse;
+
+    std::vector<Limb> modulusLimbs, oneLimbs, rSquaredLimbs;
+    // Scratch space, allocated once per context
+    std::vector<Limb> product, lhsLimbs, rhsLimbs, resultLimbs, table;
+
+    /**
+     * Copies num mod modulus into a buffer of length limbs.
+     */
+    void load(Limb *destination, const Int &num) const {
+        if(!num.isPositive() || Int::compareMagnitude(num, modulus) >= 0) {
+            load(destination, num % modulus);
+            return;
+        }
+
+        const auto &limbs = num.getLimbs();
+        const size_t used = std::min(length, static_cast<size_t>(limbs.size()));
+        std::copy(limbs.begin(), limbs.begin() + used, destination);
+        std::fill(destination + used, destination + length, 0);
+    }
+
+    /**
+     * limbs = 2 * limbs mod modulus
+     */
+    void doubleMod(Limb *limbs) const {
+        const Limb carry = addLimbs(limbs, limbs, length, limbs, length);
+        if(carry != 0 || compareLimbs(limbs, length, modulusLimbs.data(), length) >= 0) {
+            subtractLimbs(limbs, limbs, length, modulusLimbs.data(), length);
+        }
+    }
+
+    /**
+     * result = lhs * rhs / R mod modulus (coarsely integrated operand scanning). result may
+     * alias the operands.
+     */
+    void multiplyInto(Limb *result, const Limb *lhs, const Limb *rhs) {
+        Limb *t = product.data();
+        std::fill(product.begin(), product.end(), 0);
+
+        for(size_t i = 0; i < length; ++i) {
+            Limb carry = 0;
+            for(size_t j = 0; j < length; ++j) {
+                const DoubleLimb sum = static_cast<DoubleLimb>(lhs[j]) * rhs[i] + t[j] + carry;
+                t[j] = static_cast<Limb>(sum);
+                carry = static_cast<Limb>(sum >> 64);
+            }
+            DoubleLimb sum = static_cast<DoubleLimb>(t[length]) + carry;
+            t[length] = static_cast<Limb>(sum);
+            t[length + 1] = static_cast<Limb>(sum >> 64);
+
+            // Add a multiple of the modulus, so that the lowest limb becomes zero and drop it
+            const Limb factor = t[0] * negativeInverse;
+            sum = static_cast<DoubleLimb>(factor) * modulusLimbs[0] + t[0];
+            carry = static_cast<Limb>(sum >> 64);
+            for(size_t j = 1; j < length; ++j) {
+                sum = static_cast<DoubleLimb>(factor) * modulusLimbs[j] + t[j] + carry;
+                t[j - 1] = static_cast<Limb>(sum);
+                carry = static_cast<Limb>(sum >> 64);
+            }
+            sum = static_cast<DoubleLimb>(t[length]) + carry;
+            t[length - 1] = static_cast<Limb>(sum);
+            t[length] = t[length + 1] + static_cast<Limb>(sum >> 64);
+        }
+
+        if(t[length] != 0 || compareLimbs(t, length, modulusLimbs.data(), length) >= 0) {
+            subtractLimbs(t, t, length, modulusLimbs.data(), length);
+        }
+        std::copy(t, t + length, result);
+    }
+};
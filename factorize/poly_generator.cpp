@@ -1,15 +1,17 @@
 #include "poly_generator.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
+#include "fixed_int.h"
 #include "utils.h"
 
 
-PolyGenerator::PolyGenerator(const BigInt &number, const std::vector<BigInt> &basePrimes,
-                             const std::vector<BigInt> &factorBase) {
-
-    this->factorBase = factorBase;
+template<typename Int>
+BasicPolyGenerator<Int>::BasicPolyGenerator(const Int &number, const std::vector<Int> &basePrimes,
+                                            std::shared_ptr<const FactorBase> factorBase)
+                                            : factorBase(std::move(factorBase)) {
 
     assert(basePrimes.size() <= 63);
     this->number = number;
@@ -21,16 +23,27 @@ PolyGenerator::PolyGenerator(const BigInt &number, const std::vector<BigInt> &ba
 
     BValues.resize(basePrimes.size());
 
+    const std::vector<uint32_t> &primes = this->factorBase->primes;
+    const std::vector<uint32_t> &numberRoots = this->factorBase->numberRoots;
+
     // Initialize BValues
     for(int i = 0; i < basePrimes.size(); i++) {
-        BigInt frac = a/basePrimes[i];
-        BigInt inv = BigInt::modInverse(frac, basePrimes[i]);
-
-        BigInt t1 = tonelliShanks(number, basePrimes[i]);
-        BigInt t2 = (t1 * (BigInt(-1))) + basePrimes[i];
+        const Limb prime = static_cast<long long>(basePrimes[i]);
+        Int frac = a/basePrimes[i];
+        Int inv = static_cast<long long>(modInverse(frac.modSmall(prime), prime));
+
+        // Base primes are usually taken from the factor base, which already knows the root
+        Int t1;
+        const auto known = std::lower_bound(primes.begin(), primes.end(), static_cast<long long>(basePrimes[i]));
+        if(known != primes.end() && *known == static_cast<long long>(basePrimes[i])) {
+            t1 = static_cast<long long>(numberRoots[known - primes.begin()]);
+        } else {
+            t1 = static_cast<long long>(tonelliShanks(number.modSmall(prime), prime));
+        }
+        Int t2 = (t1 * (Int(-1))) + basePrimes[i];
 
-        const BigInt gamma1 = (t1 * inv) % basePrimes[i];
-        const BigInt gamma2 = (t2 * inv) % basePrimes[i];
+        const Int gamma1 = static_cast<long long>((t1 * inv).modSmall(prime));
+        const Int gamma2 = static_cast<long long>((t2 * inv).modSmall(prime));
 
         if(gamma1 > gamma2) {
             BValues[i] = frac * gamma2;
@@ -39,26 +52,40 @@ PolyGenerator::PolyGenerator(const BigInt &number, const std::vector<BigInt> &ba
         }
     }
 
-    // precompute addFactors
-    addFactors.resize(factorBase.size(), std::vector<BigInt>(basePrimes.size()));
+    firstB = 0;
+    for(const auto & BValue : BValues) {
+        firstB += BValue;
+    }
+    firstB %= a;
+
+    // precompute addFactors, and everything needed to solve for any polynomial from scratch
+    const size_t primeCount = primes.size();
+    aInverses.resize(primeCount);
+    addFactors.resize(basePrimes.size() * primeCount);
 
+    for(int i = 0; i < primeCount; i++) {
+        // Roots are updated with a plain 32 bit add and conditional subtract, which must not wrap
+        assert(primes[i] < (1U << 31));
+        const uint32_t prime = primes[i];
 
-    for(int i = 0; i < factorBase.size(); i++) {
-        const BigInt aInv = BigInt::modInverse(a, factorBase[i]);
+        const Limb aModPrime = a.modSmall(prime);
+        if(aModPrime == 0) {
+            basePrimeIndices.push_back(i);
+            continue;
+        }
+        const uint64_t aInv = modInverse(aModPrime, prime);
+        aInverses[i] = aInv;
         for(int j = 0; j < basePrimes.size(); j++) {
-            addFactors[i][j] = BigInt(2) * BValues[j] * aInv;
-            addFactors[i][j] %= factorBase[i];
+            addFactors[j * primeCount + i] = 2 * BValues[j].modSmall(prime) * aInv % prime;
         }
     }
 
 }
 
-Polynomial PolyGenerator::next() {
+template<typename Int>
+BasicPolynomial<Int> BasicPolyGenerator<Int>::next() {
     if(counter == 0) {
-        for(const auto & BValue : BValues) {
-            b += BValue;
-        }
-        b %= a;
+        b = firstB;
         counter = 1;
         assert(((b*b) % a) == (number % a));
         return {a, b, number};
@@ -68,7 +95,7 @@ Polynomial PolyGenerator::next() {
     const long long mu = __builtin_ctz(counter & -counter);
     // calculates ceil(counter/2^(mu))
     const long long exponent = 1LL + (counter - 1LL)/(1LL<<(mu + 1LL));
-    BigInt multiplier = 2;
+    Int multiplier = 2;
     // Check if exponent is odd
     if(exponent & 1) {
         multiplier *= -1;
@@ -83,55 +110,96 @@ Polynomial PolyGenerator::next() {
 }
 
 
-std::vector<std::pair<BigInt, BigInt>> PolyGenerator::findSolutions(const std::vector<std::pair<BigInt, BigInt>> &lastSolutions,
-                                                const Polynomial &polynomial) const {
-
-    std::vector<std::pair<BigInt, BigInt>> solutions(factorBase.size());
-
-    const long long mu = __builtin_ctz((counter - 1) & -(counter - 1));
-    // calculates ceil((counter - 1)/2^(mu))
-    const long long exponent = 1LL + (counter - 2LL)/(1LL<<(mu + 1LL));
-
-    auto multiplier = BigInt(1);
-    if(!(exponent & 1)) {
-        multiplier *= -1;
+template<typename Int>
+void BasicPolyGenerator<Int>::findSolutions(PolynomialSolutions &solutions,
+                                            const BasicPolynomial<Int> &polynomial) const {
+    const std::vector<uint32_t> &primes = factorBase->primes;
+    const std::vector<uint32_t> &numberRoots = factorBase->numberRoots;
+    const size_t primeCount = primes.size();
+    uint32_t *first = nullptr;
+    uint32_t *second = nullptr;
+
+    if(solutions.empty()) {
+        solutions.first.resize(primeCount);
+        solutions.second.resize(primeCount);
+        first = solutions.first.data();
+        second = solutions.second.data();
+        for(int i = 0; i < primeCount; ++i) {
+            const uint64_t prime = primes[i];
+            const uint64_t bModPrime = polynomial.b.modSmall(prime);
+            first[i] = aInverses[i] * (numberRoots[i] + prime - bModPrime) % prime;
+            second[i] = aInverses[i] * (2 * prime - numberRoots[i] - bModPrime) % prime;
+        }
+    } else {
+        assert(solutions.first.size() == primeCount && solutions.second.size() == primeCount);
+
+        const long long mu = __builtin_ctz((counter - 1) & -(counter - 1));
+        // calculates ceil((counter - 1)/2^(mu))
+        const long long exponent = 1LL + (counter - 2LL)/(1LL<<(mu + 1LL));
+
+        first = solutions.first.data();
+        second = solutions.second.data();
+        const uint32_t *add = addFactors.data() + mu * primeCount;
+        // All values are below 2^31, so a sum never wraps and a negative difference wraps to a
+        // value above any prime. Both loops compile to plain vector code.
+        if(exponent & 1) {
+            for(size_t i = 0; i < primeCount; ++i) {
+                const uint32_t sol1 = first[i] + add[i];
+                const uint32_t sol2 = second[i] + add[i];
+                first[i] = sol1 >= primes[i] ? sol1 - primes[i] : sol1;
+                second[i] = sol2 >= primes[i] ? sol2 - primes[i] : sol2;
+            }
+        } else {
+            for(size_t i = 0; i < primeCount; ++i) {
+                const uint32_t sol1 = first[i] - add[i];
+                const uint32_t sol2 = second[i] - add[i];
+                first[i] = sol1 >= primes[i] ? sol1 + primes[i] : sol1;
+                second[i] = sol2 >= primes[i] ? sol2 + primes[i] : sol2;
+            }
+        }
     }
 
-    for(int i = 0; i < factorBase.size(); ++i) {
-        if(lastSolutions.empty() || lastSolutions[i].first == BigInt(-1)) {
-            // Needs to be solved from scratch
-            const BigInt root = tonelliShanks(number, factorBase[i]);
-            const BigInt aInv = BigInt::modInverse(polynomial.a, factorBase[i]);
-            BigInt sol1 = root;
-            sol1 -= polynomial.b;
-            sol1 *= aInv;
-            sol1 %= factorBase[i];
-
-            BigInt sol2 = (root * BigInt(-1)) - polynomial.b;
-            sol2 *= aInv;
-            sol2 %= factorBase[i];
-
-
-            solutions[i] = {sol1, sol2};
-            continue;
-        }
+    // a has no inverse modulo a base prime, it is marked with the solutions (p, p)
+    for(const int index : basePrimeIndices) {
+        first[index] = primes[index];
+        second[index] = primes[index];
+    }
+}
 
-        BigInt addFactor = addFactors[i][mu] * multiplier;
 
-        BigInt sol1 = (lastSolutions[i].first + addFactor) % factorBase[i];
-        BigInt sol2 = (lastSolutions[i].second + addFactor) % factorBase[i];
+template<typename Int>
+bool BasicPolyGenerator<Int>::hasNext() const {
+    return counter < polynomialCount();
+}
 
+template<typename Int>
+long long BasicPolyGenerator<Int>::polynomialCount() const {
+    return 1LL<<(BValues.size() - 1);
+}
 
+template<typename Int>
+void BasicPolyGenerator<Int>::seek(const long long index) {
+    assert(index >= 0 && index <= polynomialCount());
+    counter = index;
+    if(index == 0) {
+        b = 0;
+        return;
+    }
 
-        solutions[i] = {sol1, sol2};
+    // next() flips the sign of B_mu with mu the lowest set bit of the counter, which is the bit
+    // in which the Gray codes of counter - 1 and counter differ. So the B values with a set bit
+    // in the Gray code of the last polynomial have been subtracted.
+    const long long gray = (index - 1) ^ ((index - 1) >> 1);
+    b = firstB;
+    for(int j = 0; j < BValues.size(); ++j) {
+        if((gray >> j) & 1) {
+            b -= Int(2) * BValues[j];
+        }
     }
-    return std::move(solutions);
 }
 
-
-bool PolyGenerator::hasNext() const {
-    return counter < (1LL<<(BValues.size() - 1));
-}
+#define INSTANTIATE_POLY_GENERATOR(Int) template class BasicPolyGenerator<Int>;
+FOR_EACH_SIEVE_INT(INSTANTIATE_POLY_GENERATOR)
 
 
 
@@ -2,37 +2,69 @@
 
 #include "polynomial.h"
 #include "big_int.h"
+#include "utils.h"
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
-class PolyGenerator {
+template<typename Int>
+class BasicPolyGenerator {
 
 public:
 
-    PolyGenerator(const BigInt &number, const std::vector<BigInt> &basePrimes,
-                  const std::vector<BigInt> &factorBase);
+    /**
+     * @param factorBase Shared read only by all generators, copies of a generator only copy the
+     *                   pointer
+     */
+    BasicPolyGenerator(const Int &number, const std::vector<Int> &basePrimes,
+                       std::shared_ptr<const FactorBase> factorBase);
 
-    Polynomial next();
+    BasicPolynomial<Int> next();
 
     /**
-     * Computes the solutions for polynomial(x)=0 (mod p) for all primes in the factor base
-     * @param lastSolutions The solutions of the equation for the polynomial generated previously
+     * Computes the solutions for polynomial(x)=0 (mod p) for all primes in the factor base.
+     * Base primes, which divide a, get the solutions (p, p).
+     * @param solutions The solutions for the polynomial generated previously, which are updated
+     *                  in place. If empty, they are solved from scratch.
      * @param polynomial Polynomial to be solved. Needs to be the Polynomial the latest next()
      *                   call returned
      */
-    [[nodiscard]] std::vector<std::pair<BigInt, BigInt>> findSolutions(const std::vector<std::pair<BigInt, BigInt>> &lastSolutions,
-                                                   const Polynomial &polynomial) const;
+    void findSolutions(PolynomialSolutions &solutions, const BasicPolynomial<Int> &polynomial) const;
 
     [[nodiscard]] bool hasNext() const;
 
-    std::vector<BigInt> BValues;
+    /**
+     * @return Number of polynomials in the family, 2^(number of base primes - 1)
+     */
+    [[nodiscard]] long long polynomialCount() const;
+
+    /**
+     * Positions the generator so that next() returns the polynomial with the given index. The
+     * first findSolutions call after a seek needs to solve from scratch, with empty solutions.
+     */
+    void seek(long long index);
+
+    std::vector<Int> BValues;
 
 private:
-    BigInt a, number;
-    BigInt b = 0;
+    Int a, number;
+    Int b = 0;
 
-    std::vector<std::vector<BigInt>> addFactors;
-    std::vector<BigInt> factorBase;
+    // b of the first polynomial
+    Int firstB;
+
+    // The factor base and everything derived from it is kept in machine words, one array per
+    // quantity, so switching to the next polynomial is a single pass without any Int arithmetic.
+    std::shared_ptr<const FactorBase> factorBase;
+    // a^-1 modulo every prime of the factor base
+    std::vector<uint32_t> aInverses;
+    // 2*B_j*a^-1 modulo every prime of the factor base, at index j*factorBase.size() + i
+    std::vector<uint32_t> addFactors;
+    // Indices of the base primes in the factor base
+    std::vector<int> basePrimeIndices;
 
     long long counter = 0;
 };
+
+using PolyGenerator = BasicPolyGenerator<BigInt>;
@@ -1,22 +1,39 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
 
 #include "big_int.h"
 
-class Polynomial {
+template<typename Int>
+class BasicPolynomial {
 public:
-    Polynomial(BigInt a, BigInt b, BigInt number) : a(std::move(a)), b(std::move(b)),
-                                                            number(std::move(number)) {}
+    BasicPolynomial(Int a, Int b, Int number) : a(std::move(a)), b(std::move(b)),
+                                                number(std::move(number)) {}
 
 
-    BigInt operator()(const BigInt &input) const {
-        BigInt res = a*input + b;
+    Int operator()(const Int &input) const {
+        Int res = a*input + b;
         res *= res;
         res -= number;
         res /= a;
         return std::move(res);
     }
 
-    const BigInt a, b;
-    const BigInt number;
-};
\ No newline at end of file
+    const Int a, b;
+    const Int number;
+};
+
+using Polynomial = BasicPolynomial<BigInt>;
+
+/**
+ * Solutions of polynomial(x) = 0 (mod p) for all primes of the factor base, one array per
+ * solution. Base primes, which divide a, are marked with the solutions (p, p).
+ */
+struct PolynomialSolutions {
+    std::vector<uint32_t> first, second;
+
+    [[nodiscard]] bool empty() const {
+        return first.empty();
+    }
+};
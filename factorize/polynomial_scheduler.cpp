@@ -0,0 +1,56 @@
+#include "polynomial_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "fixed_int.h"
+
+
+template<typename Int>
+PolynomialScheduler<Int>::PolynomialScheduler(const size_t workerCount, const long long chunkSize,
+                                              FamilyFactory createFamily)
+        : chunkSize(chunkSize), createFamily(std::move(createFamily)), queues(workerCount) {
+    assert(workerCount > 0 && chunkSize > 0);
+}
+
+template<typename Int>
+PolynomialChunk<Int> PolynomialScheduler<Int>::next(const size_t worker) {
+    {
+        std::lock_guard lock(queues[worker].mutex);
+        auto &ranges = queues[worker].chunks;
+        if(!ranges.empty()) {
+            auto &range = ranges.front();
+            PolynomialChunk<Int> chunk{range.family, range.begin, std::min(range.begin + chunkSize, range.end)};
+            range.begin = chunk.end;
+            if(range.begin == range.end) ranges.pop_front();
+            return chunk;
+        }
+    }
+
+    for(size_t i = 1; i < queues.size(); ++i) {
+        auto &victim = queues[(worker + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if(!victim.chunks.empty()) {
+            auto &range = victim.chunks.back();
+            PolynomialChunk<Int> chunk{range.family, std::max(range.end - chunkSize, range.begin), range.end};
+            range.end = chunk.begin;
+            if(range.begin == range.end) victim.chunks.pop_back();
+            return chunk;
+        }
+    }
+
+    // Nothing to steal, start a new family. Its first chunk is sieved right away, the rest stays
+    // in the deque as a single range.
+    const auto family = createFamily();
+    const long long count = family->polynomialCount();
+    PolynomialChunk<Int> first{family, 0, std::min(chunkSize, count)};
+
+    if(first.end < count) {
+        std::lock_guard lock(queues[worker].mutex);
+        queues[worker].chunks.push_back({family, first.end, count});
+    }
+    return first;
+}
+
+#define INSTANTIATE_POLYNOMIAL_SCHEDULER(Int) template class PolynomialScheduler<Int>;
+FOR_EACH_SIEVE_INT(INSTANTIATE_POLYNOMIAL_SCHEDULER)
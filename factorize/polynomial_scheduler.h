@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "poly_generator.h"
+
+/**
+ * Range [begin, end) of polynomial indices of one family. The generator is shared by all chunks
+ * of the family and positioned at the start, workers sieve on a copy of it.
+ */
+template<typename Int>
+struct PolynomialChunk {
+    std::shared_ptr<const BasicPolyGenerator<Int>> family;
+    long long begin, end;
+};
+
+/**
+ * Distributes polynomial families over the sieving threads by work stealing. The polynomials of
+ * a family that are not handed out yet stay as one range in the deque of the thread that created
+ * the family, so a deque holds a few entries no matter how large the families are. A thread
+ * cuts chunks off the front of its own ranges, an idle thread cuts them off the back of the
+ * others', and only if there is nothing to steal it creates a new family. Since
+ * families can have anywhere from a few to thousands of polynomials, this keeps the threads busy
+ * with no thread stuck on a huge family while the others wait.
+ */
+template<typename Int>
+class PolynomialScheduler {
+public:
+    using FamilyFactory = std::function<std::shared_ptr<const BasicPolyGenerator<Int>>()>;
+
+    PolynomialScheduler(size_t workerCount, long long chunkSize, FamilyFactory createFamily);
+
+    /**
+     * @return The next chunk for the given worker, which is never empty
+     */
+    PolynomialChunk<Int> next(size_t worker);
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        // Remaining ranges of whole families, chunks are split off on demand
+        std::deque<PolynomialChunk<Int>> chunks;
+    };
+
+    long long chunkSize;
+    FamilyFactory createFamily;
+    std::vector<WorkerQueue> queues;
+};
@@ -1,16 +1,30 @@
 #include "quadratic_sieve.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <set>
 #include <functional>
 #include <random>
+#include <thread>
 
 #include "big_int.h"
+#include "fixed_int.h"
+#include "montgomery.h"
+#include "utils.h"
 
 #include <vector>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 
 
 /**
@@ -19,12 +33,14 @@
  * @param factorBase factor base of prime numbers
  * @return Exponents of the prime factorization of number
  */
-std::vector<int> computeFactors(BigInt number, const std::vector<BigInt> &factorBase) {
+template<typename Int>
+std::vector<int> computeFactors(Int number, const std::vector<Int> &factorBase) {
 
     std::vector<int> exponents(factorBase.size());
     for(int i = 0; i < factorBase.size(); ++i) {
-        while((number % factorBase[i]) == 0) {
-            number /= factorBase[i];
+        const LimbDivisor prime(static_cast<long long>(factorBase[i]));
+        while(number.modSmall(prime) == 0) {
+            number.divSmall(prime);
             exponents[i]++;
         }
     }
@@ -34,89 +50,122 @@ std::vector<int> computeFactors(BigInt number, const std::vector<BigInt> &factor
 }
 
 /**
- *
- * @param factorizationExponents
- * @return List of indices, specifying which numbers need to be multiplied to get a square
+ * dst ^= src over the given number of 64-bit words
  */
-std::set<int> computeLinearDependency(const std::vector<std::vector<int>> &factorizationExponents) {
+void xorRow(uint64_t *dst, const uint64_t *src, const size_t words) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for(; i + 4 <= words; i += 4) {
+        const __m256i lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        const __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(lhs, rhs));
+    }
+#endif
+    for(; i < words; ++i) {
+        dst[i] ^= src[i];
+    }
+}
 
+std::vector<std::set<int>> computeNullSpace(const std::vector<std::vector<int>> &factorizationExponents) {
     assert(!factorizationExponents.empty());
-    std::vector<std::vector<bool>> basis(factorizationExponents[0].size());
-    std::vector<std::vector<bool>> exponents(factorizationExponents.size());
-
-    std::vector<std::set<int>> originalVectorsUsed(basis.size());
-
-    for(int i = 0; i < exponents.size(); ++i) {
-        exponents[i].resize(basis.size());
-        for(int j = 0; j < basis.size(); ++j) {
-            exponents[i][j] = (factorizationExponents[i][j] % 2) != 0;
+    const size_t rowCount = factorizationExponents.size();
+    const size_t columnCount = factorizationExponents[0].size();
+
+    // Every row holds the exponent vector mod 2, followed by a row of the identity matrix. The
+    // identity part records which relations have been added into the row.
+    const size_t exponentWords = (columnCount + 63) / 64;
+    const size_t stride = exponentWords + (rowCount + 63) / 64;
+    std::vector<uint64_t> matrix(rowCount * stride);
+    for(size_t i = 0; i < rowCount; ++i) {
+        uint64_t *row = matrix.data() + i * stride;
+        for(size_t j = 0; j < columnCount; ++j) {
+            if(factorizationExponents[i][j] & 1) {
+                row[j / 64] |= uint64_t(1) << (j % 64);
+            }
         }
+        row[exponentWords + i / 64] |= uint64_t(1) << (i % 64);
     }
 
+    std::vector<bool> pivot(rowCount);
+    for(size_t column = 0; column < columnCount; ++column) {
+        const size_t word = column / 64;
+        const uint64_t bit = uint64_t(1) << (column % 64);
 
-    for(int i = 0; i < exponents.size(); ++i) {
-        bool added = false;
-        std::set<int> usedVectors;
-        usedVectors.emplace(i);
-
-        for(int j = 0; j < basis.size(); ++j) {
-            if(!exponents[i][j]) continue;
-
-            if(basis[j].empty()) {
-                basis[j] = exponents[i];
-                originalVectorsUsed[j] = usedVectors;
-                added = true;
-                break;
-            }
-
-            for(int k = 0; k < basis.size(); ++k) {
-                exponents[i][k] = basis[j][k] ^ exponents[i][k];
+        size_t pivotRow = 0;
+        while(pivotRow < rowCount && (pivot[pivotRow] || !(matrix[pivotRow * stride + word] & bit))) {
+            ++pivotRow;
+        }
+        if(pivotRow == rowCount) continue;
+        pivot[pivotRow] = true;
+
+        // All columns before this one are already eliminated from the pivot row, so the
+        // words before word can be skipped
+        const uint64_t *source = matrix.data() + pivotRow * stride;
+        for(size_t i = 0; i < rowCount; ++i) {
+            uint64_t *row = matrix.data() + i * stride;
+            if(i != pivotRow && (row[word] & bit)) {
+                xorRow(row + word, source + word, stride - word);
             }
+        }
+    }
 
-            // add originalVectorsUsed[j] to usedVectors
-            for(const auto &v : originalVectorsUsed[j]) {
-                if(usedVectors.contains(v)) {
-                    usedVectors.erase(v);
-                } else {
-                    usedVectors.emplace(v);
-                }
+    // Rows that never became a pivot are zero in the exponent part. Their identity parts are
+    // independent and span the null space.
+    std::vector<std::set<int>> dependencies;
+    for(size_t i = 0; i < rowCount; ++i) {
+        if(pivot[i]) continue;
+        const uint64_t *row = matrix.data() + i * stride + exponentWords;
+        std::set<int> dependency;
+        for(size_t j = 0; j < rowCount; ++j) {
+            if((row[j / 64] >> (j % 64)) & 1) {
+                dependency.emplace(static_cast<int>(j));
             }
-
         }
+        dependencies.emplace_back(std::move(dependency));
+    }
+    return dependencies;
+}
 
-        if(added) continue;
-
-        // Linear dependency has been found
-        std::cout << "Linear dependency found" << std::endl;
-        return std::move(usedVectors);
+/**
+ *
+ * @param factorizationExponents
+ * @return List of indices, specifying which numbers need to be multiplied to get a square
+ */
+std::set<int> computeLinearDependency(const std::vector<std::vector<int>> &factorizationExponents) {
+    std::vector<std::set<int>> dependencies = computeNullSpace(factorizationExponents);
+    if(dependencies.empty()) {
+        std::cerr << "No linear dependency found" << std::endl;
+        return {};
     }
 
-    std::cerr << "No linear dependency found" << std::endl;
-    return {};
+    std::cout << "Linear dependency found" << std::endl;
+    return std::move(dependencies.front());
 }
 
-std::pair<BigInt, BigInt> computeSquareCongruence(const std::set<int> &square,
+template<typename Int>
+std::pair<Int, Int> computeSquareCongruence(const std::set<int> &square,
                      const std::vector<std::vector<int>> &factorizationExponents,
-                     const std::vector<BigInt> &factorBase,
-                     const std::vector<std::pair<BigInt, BigInt>> &equivPairs,
-                     const BigInt &number) {
+                     const std::vector<Int> &factorBase,
+                     const std::vector<std::pair<Int, Int>> &equivPairs,
+                     const Int &number) {
+
+    Montgomery<Int> context(number);
 
-    BigInt square1 = 1;
+    Int square1 = 1;
     std::vector<int> cntExponents(factorBase.size());
     for(const int i : square) {
 
-        square1 *= equivPairs[i].first;
-        square1 %= number;
+        square1 = context.multiplyMod(square1, equivPairs[i].first);
 
         for(int j = 0; j < factorizationExponents[i].size(); ++j) {
             cntExponents[j] += factorizationExponents[i][j];
         }
     }
 
-    BigInt square2 = 1;
+    Int square2 = 1;
     for(int i = 0; i < cntExponents.size(); ++i) {
-        square2 *= BigInt::exp(factorBase[i], cntExponents[i]/2, number);
-        square2 %= number;
+        if(cntExponents[i] < 2) continue;
+        square2 = context.multiplyMod(square2, context.exp(factorBase[i], cntExponents[i]/2));
     }
 
     if(square1 < square2) {
@@ -126,80 +175,444 @@ std::pair<BigInt, BigInt> computeSquareCongruence(const std::set<int> &square,
     return std::make_pair(std::move(square1), std::move(square2));
 }
 
+template<typename Int>
+std::optional<Int> findSquareFactor(const std::vector<std::set<int>> &dependencies,
+                                    const std::vector<std::vector<int>> &factorizationExponents,
+                                    const std::vector<Int> &primes,
+                                    const std::vector<std::pair<Int, Int>> &equivPairs,
+                                    const Int &number, const unsigned threadCount) {
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> found = false;
+    std::mutex mutex;
+    std::optional<Int> result;
+
+    const auto tryDependencies = [&]() {
+        for(size_t i = next++; i < dependencies.size() && !found; i = next++) {
+            auto [first, second] = computeSquareCongruence(dependencies[i], factorizationExponents,
+                                                           primes, equivPairs, number);
+
+            if((first * first) % number != (second * second) % number) {
+                std::cerr << "squares not equal" << std::endl;
+                continue;
+            }
+
+            Int factor = Int::gcd(first - second, number);
+            if(factor == 1 || factor == number) continue;
 
-std::vector<BigInt> sieveSolution(const BigInt &prime, const BigInt &solution, const long long range,
-                   std::vector<BigInt> sieve) {
+            std::lock_guard lock(mutex);
+            if(!found) {
+                result = std::move(factor);
+                found = true;
+            }
+        }
+    };
 
-    const long long multiplier = (-range - static_cast<long long>(solution)) / static_cast<long long>(prime);
-    BigInt index = solution + multiplier*prime;
-    assert(BigInt::abs(index) <= range);
-    while(index < range) {
-        sieve[static_cast<long long>(index)+ range] += BigInt::log2(prime);
-        index += prime;
+    std::vector<std::thread> threads;
+    for(unsigned i = 1; i < std::min<size_t>(threadCount, dependencies.size()); ++i) {
+        threads.emplace_back(tryDependencies);
     }
+    tryDependencies();
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    return result;
+}
 
-    return std::move(sieve);
+
+template<typename Int>
+std::vector<uint8_t> computePrimeLogs(const std::vector<Int> &factorBase) {
+    std::vector<uint8_t> logs;
+    logs.reserve(factorBase.size());
+    for(const auto &prime : factorBase) {
+        logs.emplace_back(static_cast<uint8_t>(std::lround(std::log2(static_cast<double>(static_cast<long long>(prime))))));
+    }
+    return logs;
 }
 
 
-std::vector<std::pair<BigInt, BigInt>> sievePolynomial(const Polynomial& polynomial,
-                                                 const std::vector<std::pair<BigInt, BigInt>> &solutions,
-                                                 const std::vector<BigInt> &factorBase,
-                                                 const long long sieveRange) {
+/**
+ * Index of the first entry of the interval [-range, range] whose offset x satisfies
+ * x = solution mod prime. Indices start at 0 for x = -range.
+ */
+long long firstSieveIndex(const long long prime, const long long solution, const long long range) {
+    const long long multiplier = (-range - solution) / prime;
+    const long long index = solution + multiplier*prime + range;
+    assert(index >= 0 && index < prime + 2*range + 1);
+    return index;
+}
 
-    std::vector<BigInt> sieve(2*sieveRange+1, 0);
 
-    for(int i = 0; i < solutions.size(); ++i) {
+/**
+ * Adds a logarithm to a sieve entry, clamping at 255 instead of wrapping around
+ */
+uint8_t addLog(const uint8_t entry, const uint8_t primeLog) {
+    const unsigned sum = static_cast<unsigned>(entry) + primeLog;
+    return static_cast<uint8_t>(sum > 255 ? 255 : sum);
+}
 
-        BigInt sol1 = solutions[i].first;
-        BigInt sol2 = solutions[i].second;
+/**
+ * Adds the logarithm of the prime to every entry of the block [blockStart, blockEnd) the root
+ * hits and advances the root to its first index after the block.
+ */
+void sieveSolution(SieveRoot &root, const long long blockStart, const long long blockEnd, uint8_t *block) {
+    long long index = root.next;
+    for(; index < blockEnd; index += root.prime) {
+        block[index - blockStart] = addLog(block[index - blockStart], root.primeLog);
+    }
+    root.next = index;
+}
+
+
+/**
+ * Sorts all hits of a root of a large prime into the buckets of the blocks they fall into.
+ * Such a prime hits a block at most once, so this replaces the per block loop of sieveSolution
+ * by a single pass over the interval.
+ */
+void fillBuckets(const long long prime, const long long first, const uint32_t factorIndex,
+                 const long long length, std::vector<std::vector<BucketEntry>> &buckets) {
+    for(long long index = first; index < length; index += prime) {
+        buckets[index / sieveBlockSize].push_back({static_cast<uint32_t>(index % sieveBlockSize), factorIndex});
+    }
+}
 
-        if(sol1 == sol2 && sol1 == factorBase[i]) {
+
+/**
+ * Appends offset + i to candidates for every entry sieve[i] >= threshold. Compares 32 (AVX2) or
+ * 16 (SSE2) bytes at once where available, and only touches candidates for the set bits of
+ * the comparison mask.
+ */
+void scanSieve(const uint8_t *sieve, const size_t length, const uint8_t threshold, const long long offset,
+               std::vector<long long> &candidates) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold));
+    for(; i + 32 <= length; i += 32) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sieve + i));
+        // values >= threshold exactly where max(values, threshold) == values
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(values, limit), values)));
+        while(mask != 0) {
+            candidates.push_back(offset + static_cast<long long>(i) + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    for(; i + 16 <= length; i += 16) {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sieve + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(values, limit), values)));
+        while(mask != 0) {
+            candidates.push_back(offset + static_cast<long long>(i) + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for(; i < length; ++i) {
+        if(sieve[i] >= threshold) candidates.push_back(offset + static_cast<long long>(i));
+    }
+}
+
+
+/**
+ * A candidate at offset x needs sieve value of at least 2/3 of log2(2*|x|*sqrt(number)), the size
+ * of polynomial(x). That only changes at powers of two of |x|, so the interval splits into a few
+ * pieces with a constant cutoff each.
+ * @return The first index of every piece and its cutoff, sorted by index
+ */
+std::vector<std::pair<long long, uint8_t>> computeCutoffs(const long long sieveRange, const long long rootBits) {
+    const auto cutoff = [rootBits](const long long bit) {
+        return static_cast<uint8_t>(std::min<long long>(255, (bit + rootBits) * 2 / 3));
+    };
+
+    std::vector<std::pair<long long, uint8_t>> cutoffs;
+    const int topBit = sieveRange > 0 ? 63 - __builtin_clzll(sieveRange) : -1;
+    // |x| in [2^bit, 2^(bit+1)) for negative x, then x = 0, then the same for positive x
+    for(int bit = topBit; bit >= 0; --bit) {
+        const long long start = std::max(-sieveRange, -((1LL << (bit + 1)) - 1));
+        cutoffs.emplace_back(start + sieveRange, cutoff(bit));
+    }
+    cutoffs.emplace_back(sieveRange, 0);
+    for(int bit = 0; bit <= topBit; ++bit) {
+        cutoffs.emplace_back((1LL << bit) + sieveRange, cutoff(bit));
+    }
+    return cutoffs;
+}
+
+
+template<typename Int>
+std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int>& polynomial,
+                                           const PolynomialSolutions &solutions,
+                                           const std::vector<Int> &factorBase,
+                                           const std::vector<uint8_t> &primeLogs,
+                                           const long long sieveRange,
+                                           const long long largePrimeBound,
+                                           const long long doubleLargePrimeBound,
+                                           SieveBuffers &buffers) {
+
+    // All prime factors of the cofactor are larger than the factor base, so it is prime as long as
+    // it is below the square of the largest one
+    const auto largestPrime = static_cast<long long>(factorBase.back());
+    assert(largePrimeBound <= 0 || largePrimeBound / largestPrime <= largestPrime);
+    assert(doubleLargePrimeBound <= 0 || doubleLargePrimeBound / largestPrime <= largePrimeBound);
+
+    const long long length = 2*sieveRange + 1;
+    const long long blockCount = (length + sieveBlockSize - 1) / sieveBlockSize;
+
+    // Primes below the threshold are sieved block by block, larger ones go through the buckets
+    auto &roots = buffers.roots;
+    auto &buckets = buffers.buckets;
+    roots.clear();
+    buckets.resize(std::max<size_t>(buckets.size(), blockCount));
+    for(auto &bucket : buckets) {
+        bucket.clear();
+    }
+    std::vector<int> basePrimes;
+    for(int i = 0; i < solutions.first.size(); ++i) {
+
+        const uint32_t sol1 = solutions.first[i];
+        const uint32_t sol2 = solutions.second[i];
+        const auto prime = static_cast<long long>(factorBase[i]);
+
+        if(sol1 == sol2 && sol1 == prime) {
             // factorBase[i] is a base prime, skipping
+            basePrimes.push_back(i);
             continue;
         }
 
-        sieve = sieveSolution(factorBase[i], sol1, sieveRange, std::move(sieve));
-
-        if(sol1 != sol2) sieve = sieveSolution(factorBase[i], sol2, sieveRange, std::move(sieve));
+        const long long first1 = firstSieveIndex(prime, sol1, sieveRange);
+        const long long first2 = firstSieveIndex(prime, sol2, sieveRange);
+        if(prime < bucketSieveThreshold) {
+            roots.push_back({prime, first1, static_cast<uint32_t>(i), primeLogs[i]});
+            if(sol1 != sol2) roots.push_back({prime, first2, static_cast<uint32_t>(i), primeLogs[i]});
+        } else {
+            fillBuckets(prime, first1, i, length, buckets);
+            if(sol1 != sol2) fillBuckets(prime, first2, i, length, buckets);
+        }
     }
 
-    std::vector<std::pair<BigInt, BigInt>> result;
+    std::vector<Relation<Int>> result;
+
+    // The interval is sieved one cache sized block at a time, with one byte per entry. The logs
+    // summed into an entry are bounded by the bit length of polynomial(x), about rootBits plus
+    // the bits of sieveRange, which passes 255 for numbers above roughly 470 bits. Entries
+    // saturate at 255 instead of wrapping, and no cutoff is above 255, so a saturated entry is
+    // always a candidate.
+    auto &block = buffers.block;
+    block.resize(sieveBlockSize);
+
+    const long long rootBits = static_cast<long long>(polynomial.number.bitLength() + 1) / 2;
+    const auto cutoffs = computeCutoffs(sieveRange, rootBits);
+    auto &candidates = buffers.candidates;
+    auto &candidatePrimes = buffers.candidatePrimes;
+    auto &candidateSlots = buffers.candidateSlots;
+    candidateSlots.resize(sieveBlockSize, -1);
+
+    for(long long blockStart = 0; blockStart < length; blockStart += sieveBlockSize) {
+        const long long blockEnd = std::min(length, blockStart + sieveBlockSize);
+        auto &bucket = buckets[blockStart / sieveBlockSize];
+        std::fill(block.begin(), block.end(), 0);
+        for(auto &sieveRoot : roots) {
+            sieveSolution(sieveRoot, blockStart, blockEnd, block.data());
+        }
+        for(const auto &entry : bucket) {
+            block[entry.offset] = addLog(block[entry.offset], primeLogs[entry.factorIndex]);
+        }
+
+        candidates.clear();
+        for(size_t piece = 0; piece < cutoffs.size(); ++piece) {
+            const long long start = std::max(cutoffs[piece].first, blockStart);
+            const long long end = std::min(piece + 1 < cutoffs.size() ? cutoffs[piece + 1].first : length, blockEnd);
+            if(start >= end) continue;
+            scanSieve(block.data() + (start - blockStart), end - start, cutoffs[piece].second, start, candidates);
+        }
+        if(candidates.empty()) continue;
+
+        // Record which primes hit the candidates. Every root has moved to its first hit after the
+        // block, so it hits a candidate exactly if the distance is a multiple of the prime. Large
+        // primes are resieved from the bucket of the block.
+        candidatePrimes.resize(std::max(candidatePrimes.size(), candidates.size()));
+        for(int c = 0; c < candidates.size(); ++c) {
+            candidatePrimes[c] = basePrimes;
+            for(const auto &sieveRoot : roots) {
+                if((sieveRoot.next - candidates[c]) % sieveRoot.prime == 0) {
+                    candidatePrimes[c].push_back(static_cast<int>(sieveRoot.factorIndex));
+                }
+            }
+            candidateSlots[candidates[c] - blockStart] = c;
+        }
+        for(const auto &entry : bucket) {
+            const int slot = candidateSlots[entry.offset];
+            if(slot >= 0) candidatePrimes[slot].push_back(static_cast<int>(entry.factorIndex));
+        }
+
+        for(int c = 0; c < candidates.size(); ++c) {
+            candidateSlots[candidates[c] - blockStart] = -1;
+
+            const long long x = candidates[c] - sieveRange;
+            auto polyVal = polynomial(x);
 
-    const BigInt root = BigInt::sqrt(polynomial.number);
-    for(int i = 0; i < sieve.size(); ++i) {
-        BigInt cutoff = 1;
-        if(i-sieveRange != 0) cutoff = BigInt::log2(2*BigInt::abs(i-sieveRange)*root);
-        cutoff *= 2;
-        cutoff /= 3;
-        if(sieve[i] < cutoff) continue;
+            // y = a * polynomial(x), a is the product of the base primes
+            Relation<Int> relation;
+            relation.factors = basePrimes;
+            for(const int index : candidatePrimes[c]) {
+                const LimbDivisor prime(static_cast<long long>(factorBase[index]));
+                while(polyVal.modSmall(prime) == 0) {
+                    polyVal.divSmall(prime);
+                    relation.factors.push_back(index);
+                }
+            }
 
-        auto polyVal = polynomial(i-sieveRange);
-        for(int j = 0; j < factorBase.size(); ++j) {
-            if((polyVal % factorBase[j]) == 0) {
-                polyVal /= factorBase[j];
+            if(polyVal > 1 && polyVal < largePrimeBound) {
+                // Partial relation, one large prime is left over
+                relation.largePrimes[1] = static_cast<long long>(polyVal);
+            } else if(polyVal > 1 && polyVal < doubleLargePrimeBound) {
+                // Below largePrimeBound times the largest factor base prime, a composite cofactor
+                // splits into two primes that are both below largePrimeBound
+                const auto cofactor = static_cast<uint64_t>(static_cast<long long>(polyVal));
+                if(isPrime(cofactor)) continue;
+                const uint64_t factor = splitCofactor(cofactor);
+                if(factor == 0) continue;
+                relation.largePrimes = {static_cast<long long>(std::min(factor, cofactor / factor)),
+                                        static_cast<long long>(std::max(factor, cofactor / factor))};
+                if(relation.largePrimes[1] >= largePrimeBound) continue;
+            } else if(polyVal != 1) {
+                continue;
             }
+
+            relation.x = polynomial.a * x + polynomial.b;
+            relation.y = relation.x * relation.x - polynomial.number;
+            result.emplace_back(std::move(relation));
         }
+    }
+
+    return std::move(result);
+
+}
 
-        if(polyVal == 1) {
-            BigInt x = polynomial.a * (i-sieveRange) + polynomial.b;
-            BigInt y = x*x - polynomial.number;
-            result.emplace_back(x, y);
+template<typename Int>
+std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int>& polynomial,
+                                           const PolynomialSolutions &solutions,
+                                           const std::vector<Int> &factorBase,
+                                           const std::vector<uint8_t> &primeLogs,
+                                           const long long sieveRange,
+                                           const long long largePrimeBound,
+                                           const long long doubleLargePrimeBound) {
+    SieveBuffers buffers;
+    return sievePolynomial(polynomial, solutions, factorBase, primeLogs, sieveRange, largePrimeBound,
+                           doubleLargePrimeBound, buffers);
+}
+
+template<typename Int>
+Relation<Int> combineRelations(const std::vector<Relation<Int>> &partials, const Int &number) {
+    Relation<Int> result;
+    result.x = 1;
+    std::map<long long, int> largePrimeCounts;
+    for(const auto &partial : partials) {
+        result.x = (result.x * partial.x) % number;
+        result.factors.insert(result.factors.end(), partial.factors.begin(), partial.factors.end());
+        for(const long long prime : partial.largePrimes) {
+            if(prime != 1) largePrimeCounts[prime]++;
         }
     }
 
+    // The product of the ys contains the square of root, which is divided out of x
+    Int root = 1;
+    for(const auto &[prime, count] : largePrimeCounts) {
+        assert(count % 2 == 0);
+        for(int i = 0; i < count / 2; ++i) {
+            root = (root * Int(prime)) % number;
+        }
+    }
+    result.x = (result.x * Int::modInverse(root, number)) % number;
+    result.y = (result.x * result.x) % number;
     return std::move(result);
+}
 
+template<typename Int>
+std::vector<Relation<Int>> filterRelations(std::vector<Relation<Int>> relations, const Int &number,
+                                           const size_t primeCount, const size_t excess) {
+    // Duplicates have the same x modulo number
+    std::set<Int> xValues;
+    std::erase_if(relations, [&](const Relation<Int> &relation) {
+        return !xValues.insert(relation.x % number).second;
+    });
+
+    // Only primes with an odd exponent decide whether relations can form a square
+    std::vector<std::vector<int>> oddPrimes(relations.size());
+    std::vector<int> primeWeights(primeCount);
+    for(int i = 0; i < relations.size(); ++i) {
+        std::vector<int> factors = relations[i].factors;
+        std::sort(factors.begin(), factors.end());
+        for(int j = 0; j < factors.size();) {
+            int k = j;
+            while(k < factors.size() && factors[k] == factors[j]) ++k;
+            if((k - j) % 2 == 1) {
+                oddPrimes[i].push_back(factors[j]);
+                primeWeights[factors[j]]++;
+            }
+            j = k;
+        }
+    }
+
+    std::vector<bool> removed(relations.size());
+    size_t remaining = relations.size();
+    const auto remove = [&](const int relation) {
+        removed[relation] = true;
+        remaining--;
+        for(const int prime : oddPrimes[relation]) {
+            primeWeights[prime]--;
+        }
+    };
+
+    for(;;) {
+        // A relation with the only odd power of a prime can not be part of a square. Removing it
+        // can leave another prime with one odd power, so repeat until nothing changes.
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            for(int i = 0; i < relations.size(); ++i) {
+                if(removed[i]) continue;
+                if(std::any_of(oddPrimes[i].begin(), oddPrimes[i].end(), [&](const int prime) { return primeWeights[prime] == 1; })) {
+                    remove(i);
+                    changed = true;
+                }
+            }
+        }
+
+        const auto activePrimes = static_cast<size_t>(std::count_if(primeWeights.begin(), primeWeights.end(), [](const int weight) { return weight > 0; }));
+        if(remaining <= activePrimes + excess) break;
+
+        // More relations than needed, the heaviest ones go. They make the matrix the densest.
+        std::vector<int> order;
+        for(int i = 0; i < relations.size(); ++i) {
+            if(!removed[i]) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](const int lhs, const int rhs) {
+            return oddPrimes[lhs].size() > oddPrimes[rhs].size();
+        });
+        const size_t surplus = remaining - activePrimes - excess;
+        for(size_t i = 0; i < surplus; ++i) {
+            remove(order[i]);
+        }
+    }
+
+    std::vector<Relation<Int>> filtered;
+    filtered.reserve(remaining);
+    for(int i = 0; i < relations.size(); ++i) {
+        if(!removed[i]) filtered.emplace_back(std::move(relations[i]));
+    }
+    return filtered;
 }
 
-std::vector<BigInt> selectBasePrimes(const BigInt &number, std::vector<BigInt> factorBase, long long sieveRange) {
+template<typename Int>
+std::vector<Int> selectBasePrimes(const Int &number, std::vector<Int> factorBase, long long sieveRange) {
 
-    BigInt product = 1;
-    const BigInt target = BigInt::sqrt(BigInt(2)*number);
-    std::vector<BigInt> basePrimes;
+    Int product = 1;
+    const Int target = Int::sqrt(Int(2)*number);
+    std::vector<Int> basePrimes;
 
+    // Sieving threads pick their families at the same time, each needs its own generator
     static auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-    static std::default_random_engine rng(seed);
+    static thread_local std::default_random_engine rng(seed + std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
     std::shuffle(factorBase.begin(), factorBase.end(), rng);
 
@@ -212,3 +625,24 @@ std::vector<BigInt> selectBasePrimes(const BigInt &number, std::vector<BigInt> f
     }
     return std::move(basePrimes);
 }
+
+
+#define INSTANTIATE_SIEVE(Int) \
+    template std::vector<int> computeFactors(Int, const std::vector<Int> &); \
+    template std::pair<Int, Int> computeSquareCongruence(const std::set<int> &, \
+        const std::vector<std::vector<int>> &, const std::vector<Int> &, \
+        const std::vector<std::pair<Int, Int>> &, const Int &); \
+    template std::optional<Int> findSquareFactor(const std::vector<std::set<int>> &, \
+        const std::vector<std::vector<int>> &, const std::vector<Int> &, \
+        const std::vector<std::pair<Int, Int>> &, const Int &, unsigned); \
+    template std::vector<uint8_t> computePrimeLogs(const std::vector<Int> &); \
+    template std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int> &, \
+        const PolynomialSolutions &, const std::vector<Int> &, \
+        const std::vector<uint8_t> &, long long, long long, long long); \
+    template std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int> &, \
+        const PolynomialSolutions &, const std::vector<Int> &, \
+        const std::vector<uint8_t> &, long long, long long, long long, SieveBuffers &); \
+    template Relation<Int> combineRelations(const std::vector<Relation<Int>> &, const Int &); \
+    template std::vector<Relation<Int>> filterRelations(std::vector<Relation<Int>>, const Int &, size_t, size_t); \
+    template std::vector<Int> selectBasePrimes(const Int &, std::vector<Int>, long long);
+FOR_EACH_SIEVE_INT(INSTANTIATE_SIEVE)
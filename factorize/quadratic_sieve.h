@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <set>
 #include <vector>
 
@@ -8,22 +11,151 @@
 
 
 
-std::vector<int> computeFactors(BigInt number, const std::vector<BigInt> &factorBase);
+/**
+ * x^2 = y (mod number), with y smooth over the factor base. For a partial relation y has up to
+ * two more prime factors outside the factor base, the large primes. Relations combined from
+ * partial relations only know y modulo number.
+ */
+template<typename Int>
+struct Relation {
+    Int x, y;
+    // Indices into the factor base of the prime factors of y, repeated by their multiplicity
+    std::vector<int> factors;
+    // Ascending, 1 where there is none, so full relations have {1, 1}
+    std::array<long long, 2> largePrimes{1, 1};
+};
+
+/**
+ * Multiplies partial relations whose large primes all appear an even number of times into a
+ * full relation. The large primes must not divide number.
+ */
+template<typename Int>
+Relation<Int> combineRelations(const std::vector<Relation<Int>> &partials, const Int &number);
+
+/**
+ * Relations filterRelations keeps beyond the number of primes, every one of them adds a
+ * dimension to the null space
+ */
+constexpr size_t relationExcess = 64;
+
+/**
+ * Makes the matrix for the linear algebra as small as possible. Removes duplicate relations,
+ * then repeatedly relations with a prime that has an odd exponent in no other relation, and the
+ * heaviest relations while there are more than excess relations beyond the primes left.
+ * @param primeCount Size of the factor base
+ */
+template<typename Int>
+std::vector<Relation<Int>> filterRelations(std::vector<Relation<Int>> relations, const Int &number,
+                                           size_t primeCount, size_t excess = relationExcess);
+
+template<typename Int>
+std::vector<int> computeFactors(Int number, const std::vector<Int> &factorBase);
+
+/**
+ * Gaussian elimination over GF(2) on bit-packed rows.
+ * @param factorizationExponents Exponent vector of every relation, only the parity is used
+ * @return A basis of the null space. Every entry lists the relations whose product is a square.
+ */
+std::vector<std::set<int>> computeNullSpace(const std::vector<std::vector<int>> &factorizationExponents);
 
 std::set<int> computeLinearDependency(const std::vector<std::vector<int>> &factorizationExponents);
 
-std::pair<BigInt, BigInt> computeSquareCongruence(const std::set<int> &square,
+template<typename Int>
+std::pair<Int, Int> computeSquareCongruence(const std::set<int> &square,
                      const std::vector<std::vector<int>> &factorizationExponents,
-                     const std::vector<BigInt> &factorBase,
-                     const std::vector<std::pair<BigInt, BigInt>> &equivPairs,
-                     const BigInt &number);
+                     const std::vector<Int> &factorBase,
+                     const std::vector<std::pair<Int, Int>> &equivPairs,
+                     const Int &number);
+
+/**
+ * Computes the square congruences of the dependencies on several threads, until one of them
+ * gives a nontrivial factor.
+ * @return The factor, none if every dependency gave a trivial one
+ */
+template<typename Int>
+std::optional<Int> findSquareFactor(const std::vector<std::set<int>> &dependencies,
+                                    const std::vector<std::vector<int>> &factorizationExponents,
+                                    const std::vector<Int> &primes,
+                                    const std::vector<std::pair<Int, Int>> &equivPairs,
+                                    const Int &number, unsigned threadCount);
+
+/**
+ * Number of sieve entries processed at once. One block of bytes fits into the L1 data cache.
+ */
+constexpr long long sieveBlockSize = 32768;
+
+/**
+ * Primes from this size on hit a block at most once. They are bucket sieved: their hits are
+ * collected per block once per polynomial instead of visiting every prime in every block.
+ */
+constexpr long long bucketSieveThreshold = sieveBlockSize;
+
+/**
+ * Rounded log2 of every prime in the factor base. Computed once per factor base, the sieve
+ * adds these instead of taking logarithms of the primes over and over.
+ */
+template<typename Int>
+std::vector<uint8_t> computePrimeLogs(const std::vector<Int> &factorBase);
+
+void scanSieve(const uint8_t *sieve, size_t length, uint8_t threshold, long long offset,
+               std::vector<long long> &candidates);
+
+std::vector<std::pair<long long, uint8_t>> computeCutoffs(long long sieveRange, long long rootBits);
+
+/**
+ * Root of the polynomial modulo one factor base prime, together with the next index of the
+ * sieve interval it hits. The index carries over from one block to the next.
+ */
+struct SieveRoot {
+    long long prime;
+    long long next;
+    uint32_t factorIndex;
+    uint8_t primeLog;
+};
+
+/**
+ * Hit of a large prime in one block of the interval
+ */
+struct BucketEntry {
+    uint32_t offset;
+    uint32_t factorIndex;
+};
+
+/**
+ * Working memory of sievePolynomial. Reusing it for all polynomials saves allocating the sieve
+ * block and the buckets over and over. Every thread needs its own.
+ */
+struct SieveBuffers {
+    std::vector<uint8_t> block;
+    std::vector<SieveRoot> roots;
+    std::vector<std::vector<BucketEntry>> buckets;
+    std::vector<long long> candidates;
+    // Primes that hit each candidate and the index of the candidate for every block position
+    std::vector<std::vector<int>> candidatePrimes;
+    std::vector<int> candidateSlots;
+};
+
+template<typename Int>
+std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int>& polynomial,
+                                           const PolynomialSolutions &solutions,
+                                           const std::vector<Int> &factorBase,
+                                           const std::vector<uint8_t> &primeLogs,
+                                           long long sieveRange,
+                                           long long largePrimeBound,
+                                           long long doubleLargePrimeBound,
+                                           SieveBuffers &buffers);
 
-std::vector<std::pair<BigInt, BigInt>> sievePolynomial(const Polynomial& polynomial,
-                                                 const std::vector<std::pair<BigInt, BigInt>> &solutions,
-                                                 const std::vector<BigInt> &factorBase,
-                                                 long long sieveRange);
+template<typename Int>
+std::vector<Relation<Int>> sievePolynomial(const BasicPolynomial<Int>& polynomial,
+                                           const PolynomialSolutions &solutions,
+                                           const std::vector<Int> &factorBase,
+                                           const std::vector<uint8_t> &primeLogs,
+                                           long long sieveRange,
+                                           long long largePrimeBound,
+                                           long long doubleLargePrimeBound);
 
 BigInt polynomial(const BigInt& a, const BigInt& b, const BigInt &number, const BigInt &input);
 
-std::vector<BigInt> selectBasePrimes(const BigInt &number, std::vector<BigInt> factorBase,
-                                     long long sieveRange);
+template<typename Int>
+std::vector<Int> selectBasePrimes(const Int &number, std::vector<Int> factorBase,
+                                  long long sieveRange);
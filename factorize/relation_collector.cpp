@@ -0,0 +1,70 @@
+#include "relation_collector.h"
+
+#include <iostream>
+
+#include "fixed_int.h"
+
+
+template<typename Int>
+RelationCollector<Int>::RelationCollector(const Int &number, const size_t target) : number(number), target(target),
+                                                                                    partialRelations(number) {}
+
+template<typename Int>
+void RelationCollector<Int>::add(std::vector<Relation<Int>> newRelations) {
+    std::lock_guard lock(mutex);
+    if(done) return;
+
+    for(auto &relation : newRelations) {
+        if(!equivPairs.emplace(relation.x, relation.y).second) continue;
+
+        const auto [first, second] = relation.largePrimes;
+        if(second == 1) {
+            relations.emplace_back(std::move(relation));
+            continue;
+        }
+
+        if((first != 1 && number.modSmall(first) == 0) || number.modSmall(second) == 0) continue;
+        if(auto combined = partialRelations.add(std::move(relation))) {
+            relations.emplace_back(std::move(*combined));
+            combinedRelations++;
+        }
+    }
+
+    std::cout << "found " << relations.size() << " congruences (" << combinedRelations
+              << " from " << partialRelations.size() << " partial relations)" << std::endl;
+
+    if(relations.size() > target) {
+        std::cout << "found enough congruences, exiting..." << std::endl;
+        done = true;
+    }
+}
+
+template<typename Int>
+void RelationCollector<Int>::printBasePrimes(const std::vector<Int> &basePrimes) {
+    std::lock_guard lock(mutex);
+    std::cout << "base primes: " << std::endl;
+    for(const auto& prime : basePrimes) {
+        std::cout << "bp: " << prime << std::endl;
+    }
+}
+
+template<typename Int>
+bool RelationCollector<Int>::isDone() const {
+    return done;
+}
+
+template<typename Int>
+std::vector<Relation<Int>> RelationCollector<Int>::takeRelations() {
+    std::lock_guard lock(mutex);
+    return std::move(relations);
+}
+
+template<typename Int>
+void RelationCollector<Int>::collectMore(const size_t count) {
+    std::lock_guard lock(mutex);
+    target = relations.size() + count;
+    done = false;
+}
+
+#define INSTANTIATE_RELATION_COLLECTOR(Int) template class RelationCollector<Int>;
+FOR_EACH_SIEVE_INT(INSTANTIATE_RELATION_COLLECTOR)
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "quadratic_sieve.h"
+#include "relation_graph.h"
+
+/**
+ * Gathers the relations of all sieving threads. Duplicates are dropped, partial relations go
+ * into a LargePrimeGraph until they close a cycle. All methods may be called from several
+ * threads at once.
+ */
+template<typename Int>
+class RelationCollector {
+public:
+    /**
+     * @param target Collecting is done once there are more full relations than this
+     */
+    RelationCollector(const Int &number, size_t target);
+
+    /**
+     * Adds the relations found on one polynomial
+     */
+    void add(std::vector<Relation<Int>> newRelations);
+
+    /**
+     * Prints the base primes of a new polynomial family, without mixing them into the output
+     * of other threads
+     */
+    void printBasePrimes(const std::vector<Int> &basePrimes);
+
+    [[nodiscard]] bool isDone() const;
+
+    /**
+     * Moves the full relations out, once all threads have stopped adding
+     */
+    std::vector<Relation<Int>> takeRelations();
+
+    /**
+     * Starts collecting again after takeRelations, until there are more than count new full
+     * relations. Relations seen before are still dropped as duplicates.
+     */
+    void collectMore(size_t count);
+
+private:
+    Int number;
+    size_t target;
+
+    std::mutex mutex;
+    std::atomic<bool> done = false;
+
+    std::set<std::pair<Int, Int>> equivPairs;
+    std::vector<Relation<Int>> relations;
+    LargePrimeGraph<Int> partialRelations;
+    long long combinedRelations = 0;
+};
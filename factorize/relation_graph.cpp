@@ -0,0 +1,83 @@
+#include "relation_graph.h"
+
+#include <cassert>
+#include <deque>
+
+#include "fixed_int.h"
+
+
+template<typename Int>
+LargePrimeGraph<Int>::LargePrimeGraph(Int number) : number(std::move(number)) {}
+
+template<typename Int>
+std::optional<Relation<Int>> LargePrimeGraph<Int>::add(Relation<Int> relation) {
+    const auto [first, second] = relation.largePrimes;
+    assert(second != 1);
+
+    const long long firstRoot = find(first);
+    const long long secondRoot = find(second);
+    if(firstRoot == secondRoot) {
+        std::vector<Relation<Int>> cycle;
+        for(const int index : findPath(first, second)) {
+            cycle.emplace_back(partials[index]);
+        }
+        cycle.emplace_back(std::move(relation));
+        return combineRelations(cycle, number);
+    }
+
+    parents[firstRoot] = secondRoot;
+    const int index = static_cast<int>(partials.size());
+    edges[first].emplace_back(second, index);
+    edges[second].emplace_back(first, index);
+    partials.emplace_back(std::move(relation));
+    return std::nullopt;
+}
+
+template<typename Int>
+size_t LargePrimeGraph<Int>::size() const {
+    return partials.size();
+}
+
+template<typename Int>
+long long LargePrimeGraph<Int>::find(const long long prime) {
+    parents.try_emplace(prime, prime);
+    long long root = prime;
+    while(parents[root] != root) {
+        root = parents[root];
+    }
+
+    // Path compression
+    long long current = prime;
+    while(current != root) {
+        const long long parent = parents[current];
+        parents[current] = root;
+        current = parent;
+    }
+    return root;
+}
+
+template<typename Int>
+std::vector<int> LargePrimeGraph<Int>::findPath(const long long from, const long long to) const {
+    // Breadth first search through the forest, remembering the edge every prime was reached by
+    std::unordered_map<long long, std::pair<long long, int>> reachedBy;
+    reachedBy[from] = {from, -1};
+    std::deque<long long> queue = {from};
+    while(!queue.empty() && !reachedBy.contains(to)) {
+        const long long prime = queue.front();
+        queue.pop_front();
+        for(const auto &[neighbour, index] : edges.at(prime)) {
+            if(reachedBy.try_emplace(neighbour, prime, index).second) {
+                queue.push_back(neighbour);
+            }
+        }
+    }
+
+    std::vector<int> path;
+    for(long long prime = to; prime != from; prime = reachedBy.at(prime).first) {
+        path.push_back(reachedBy.at(prime).second);
+    }
+    return path;
+}
+
+#define INSTANTIATE_LARGE_PRIME_GRAPH(Int) template class LargePrimeGraph<Int>;
+FOR_EACH_SIEVE_INT(INSTANTIATE_LARGE_PRIME_GRAPH)
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "quadratic_sieve.h"
+
+/**
+ * Collects partial relations as edges between their two large primes, where 1 stands in for the
+ * missing second prime of a single large prime relation. A relation that closes a cycle is
+ * combined with the relations along the cycle into a full relation, since every large prime on
+ * a cycle divides exactly two of them.
+ */
+template<typename Int>
+class LargePrimeGraph {
+public:
+    explicit LargePrimeGraph(Int number);
+
+    /**
+     * Adds a partial relation. Its large primes must not divide number.
+     * @return The full relation, if the relation closes a cycle
+     */
+    std::optional<Relation<Int>> add(Relation<Int> relation);
+
+    /**
+     * @return Number of partial relations stored as edges
+     */
+    [[nodiscard]] size_t size() const;
+
+private:
+    Int number;
+    std::vector<Relation<Int>> partials;
+
+    // Union find over the large primes, to tell whether two primes are already connected
+    std::unordered_map<long long, long long> parents;
+    // Spanning forest: for every prime its neighbours and the index of the connecting relation
+    std::unordered_map<long long, std::vector<std::pair<long long, int>>> edges;
+
+    long long find(long long prime);
+
+    /**
+     * @return Indices of the relations on the path between two connected primes
+     */
+    [[nodiscard]] std::vector<int> findPath(long long from, long long to) const;
+};
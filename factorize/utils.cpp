@@ -2,24 +2,79 @@
 
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <numeric>
+#include <utility>
 
+#include "montgomery.h"
 
-std::vector<BigInt> generatePrimes(long long limit) {
 
-    std::vector<BigInt> primes;
-    std::vector<bool> isPrime(limit, true);
-    for(long long i = 2LL; i < limit; ++i) {
-        if(isPrime[i]) {
-            primes.push_back(i);
+// Bits of one segment of the prime sieve, one per odd number. 32 KiB fit into the L1 cache.
+constexpr uint64_t primeSegmentBits = 32 * 1024 * 8;
+
+void forEachPrime(const uint64_t limit, const std::function<void(uint32_t)> &callback) {
+    assert(limit <= (1ULL << 32));
+    if(limit <= 2) return;
+    callback(2);
+
+    // Bit k of the sieve stands for the odd number 2k + 1. The primes up to sqrt(limit) are
+    // found with a small sieve of the same layout first.
+    uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<long double>(limit)));
+    while(root * root >= limit) --root;
+    std::vector<uint8_t> smallComposite(root / 2 + 1);
+    std::vector<uint64_t> sievingPrimes;
+    // Index of the next odd multiple of every sieving prime that has to be crossed off
+    std::vector<uint64_t> nextMultiples;
+    for(uint64_t k = 1; k < smallComposite.size(); ++k) {
+        if(smallComposite[k]) continue;
+        const uint64_t prime = 2 * k + 1;
+        sievingPrimes.push_back(prime);
+        nextMultiples.push_back(prime * prime / 2);
+        for(uint64_t j = prime * prime / 2; j < smallComposite.size(); j += prime) {
+            smallComposite[j] = 1;
         }
-        for(long long j = 2LL*i; j < limit; j += i) {
-            isPrime[j] = false;
+    }
+
+    const uint64_t oddCount = limit / 2;
+    std::vector<uint64_t> segment(primeSegmentBits / 64);
+    for(uint64_t low = 0; low < oddCount; low += primeSegmentBits) {
+        const uint64_t high = std::min(low + primeSegmentBits, oddCount);
+        std::fill(segment.begin(), segment.end(), 0);
+        if(low == 0) {
+            // 1 is not a prime
+            segment[0] = 1;
+        }
+
+        // Crossing off starts at p^2, so only primes with p^2 below the segment end take part
+        for(size_t i = 0; i < sievingPrimes.size() && nextMultiples[i] < high; ++i) {
+            const uint64_t prime = sievingPrimes[i];
+            uint64_t j = nextMultiples[i] - low;
+            for(; j < high - low; j += prime) {
+                segment[j / 64] |= 1ULL << (j % 64);
+            }
+            nextMultiples[i] = low + j;
+        }
+
+        for(uint64_t word = 0; word * 64 < high - low; ++word) {
+            uint64_t primes = ~segment[word];
+            while(primes != 0) {
+                const uint64_t k = low + word * 64 + __builtin_ctzll(primes);
+                if(k >= high) break;
+                callback(static_cast<uint32_t>(2 * k + 1));
+                primes &= primes - 1;
+            }
         }
     }
+}
 
-    return std::move(primes);
+std::vector<uint32_t> generatePrimes(const uint64_t limit) {
+    std::vector<uint32_t> primes;
+    forEachPrime(limit, [&primes](const uint32_t prime) {
+        primes.push_back(prime);
+    });
+    return primes;
 }
 
 /**
@@ -40,80 +95,301 @@ long long nthPrime(const long long n) {
     return static_cast<long long>(res);
 }
 
-std::vector<BigInt> generateFactorBase(const long long amount, const BigInt& number) {
+FactorBase generateFactorBase(const long long amount, const BigInt& number) {
 
     const long long limit = nthPrime(amount);
 
-    std::vector<BigInt> primes = generatePrimes(limit);
-    std::vector<BigInt> factorBase;
-
-    for(const auto & prime : primes) {
-        if(isQuadraticResidue(number, prime)) {
-            factorBase.emplace_back(prime);
+    // The primes are streamed, only the ones that make it into the factor base are stored
+    FactorBase factorBase;
+    forEachPrime(limit, [&](const uint32_t prime) {
+        const Limb residue = number.modSmall(prime);
+        if(isQuadraticResidue(residue, prime)) {
+            factorBase.primes.push_back(prime);
+            factorBase.numberRoots.push_back(tonelliShanks(residue, prime));
         }
+    });
+    return factorBase;
+}
+
+FactorBase buildFactorBase(const std::vector<BigInt> &primes, const BigInt &number) {
+    FactorBase factorBase;
+    factorBase.primes.reserve(primes.size());
+    factorBase.numberRoots.reserve(primes.size());
+    for(const auto &prime : primes) {
+        assert(prime < BigInt(1LL << 32));
+        const auto word = static_cast<uint64_t>(static_cast<long long>(prime));
+        factorBase.primes.push_back(word);
+        factorBase.numberRoots.push_back(tonelliShanks(number.modSmall(word), word));
     }
-    return std::move(factorBase);
+    return factorBase;
+}
+
+/**
+ * Euler's criterion, with a Montgomery context for the prime that can be reused by the caller
+ */
+bool isQuadraticResidue(const BigInt& number, Montgomery<BigInt>& context) {
+    const BigInt exponent = (context.getModulus() - 1) / 2;
+    return context.exp(number, exponent) == BigInt(1);
 }
 
 bool isQuadraticResidue(const BigInt& number, const BigInt& prime) {
     if(prime == BigInt(2)) return true;
-    const BigInt exponent = (prime - 1) / 2;
-
-    BigInt res = BigInt::exp(number, exponent, prime);
-    return res == BigInt(1);
+    Montgomery<BigInt> context(prime);
+    return isQuadraticResidue(number, context);
 }
 
 BigInt tonelliShanks(const BigInt& number, const BigInt& prime) {
-    if(!isQuadraticResidue(number, prime)) {
+    if(prime == BigInt(2)) return number % prime;
+
+    Montgomery<BigInt> context(prime);
+    if(!isQuadraticResidue(number, context)) {
         std::cerr << "Not a quadratic residue" << std::endl;
         return BigInt("-1");
     }
 
     BigInt q = prime - BigInt(1);
     long s = 0;
-    while((q % BigInt(2)) == BigInt(0)) {
+    while(q.isEven()) {
         q /= BigInt(2);
         s++;
     }
 
     BigInt z;
-    for(z = BigInt(1); z < prime; ++z) {
-        if(!isQuadraticResidue(z, prime)) {
+    for(z = BigInt(2); z < prime; ++z) {
+        if(!isQuadraticResidue(z, context)) {
             break;
         }
     }
 
+    // c, t and r are kept in Montgomery form
+    long m = s;
+    BigInt c = context.toMontgomery(context.exp(z, q));
+    BigInt t = context.toMontgomery(context.exp(number, q));
+    BigInt r = context.toMontgomery(context.exp(number, (BigInt(1) + q) / BigInt(2)));
+    const BigInt one = context.one();
 
-    BigInt m = s;
-    BigInt c = BigInt::exp(z, q, prime);
-    BigInt t = BigInt::exp(number, q, prime);
-    BigInt r = BigInt::exp(number, (BigInt(1) + q) / BigInt(2), prime);
+    while(t != BigInt(0) && t != one) {
+        // Find the least i with t^(2^i) == 1 by successive squaring
+        long i = 0;
+        for(BigInt power = t; power != one; power = context.square(power)) {
+            i++;
+        }
 
-    while(t != BigInt(0) && t != BigInt(1)) {
-        auto exponent = BigInt(1);
-        BigInt i;
+        BigInt b = c;
+        for(long j = 0; j < m - i - 1; ++j) {
+            b = context.square(b);
+        }
+        m = i;
 
-        for(i = BigInt(1); i < m; ++i) {
-            exponent *= BigInt(2);
+        c = context.square(b);
+        t = context.multiply(t, c);
+        r = context.multiply(r, b);
+    }
 
-            if(BigInt::exp(t, exponent, prime) == BigInt(1)) {
-                break;
-            }
-        }
+    if(t == BigInt(0)) return {0};
+    return context.fromMontgomery(r);
+}
 
 
-        exponent = BigInt::exp(BigInt(2), m - i - BigInt(1), BigInt(0));
-        BigInt b = BigInt::exp(c, exponent, prime);
-        m = i;
+uint64_t mulMod(const uint64_t lhs, const uint64_t rhs, const uint64_t modulus) {
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(lhs) * rhs % modulus);
+}
 
-        c = (b * b) % prime;
-        t *= c;
-        t %= prime;
-        r *= b;
-        r %= prime;
+uint64_t expMod(uint64_t base, uint64_t exponent, const uint64_t modulus) {
+    uint64_t result = 1;
+    base %= modulus;
+    while(exponent > 0) {
+        if(exponent & 1) result = mulMod(result, base, modulus);
+        base = mulMod(base, base, modulus);
+        exponent >>= 1;
     }
+    return result;
+}
 
-    if(t == BigInt(0)) return {0};
+/**
+ * Jacobi symbol (number/modulus) for an odd modulus, from quadratic reciprocity
+ */
+int jacobiSymbol(uint64_t number, uint64_t modulus) {
+    assert(modulus & 1);
+    number %= modulus;
+    int result = 1;
+    while(number != 0) {
+        const int twos = __builtin_ctzll(number);
+        number >>= twos;
+        // (2/modulus) is -1 for modulus = 3, 5 (mod 8)
+        if((twos & 1) && ((modulus & 7) == 3 || (modulus & 7) == 5)) result = -result;
+        if((number & 3) == 3 && (modulus & 3) == 3) result = -result;
+        std::swap(number, modulus);
+        number %= modulus;
+    }
+    return modulus == 1 ? result : 0;
+}
+
+bool isQuadraticResidue(const uint64_t number, const uint64_t prime) {
+    if(prime == 2) return true;
+    return jacobiSymbol(number, prime) == 1;
+}
+
+uint64_t tonelliShanks(uint64_t number, const uint64_t prime) {
+    if(prime == 2) return number % 2;
+    number %= prime;
+    if(number == 0) return 0;
+    assert(isQuadraticResidue(number, prime));
+
+    uint64_t q = prime - 1;
+    long s = 0;
+    while(q % 2 == 0) {
+        q /= 2;
+        s++;
+    }
+
+    uint64_t z = 2;
+    while(isQuadraticResidue(z, prime)) {
+        z++;
+    }
+
+    long m = s;
+    uint64_t c = expMod(z, q, prime);
+    uint64_t t = expMod(number, q, prime);
+    uint64_t r = expMod(number, (q + 1) / 2, prime);
+
+    while(t != 1) {
+        // Find the least i with t^(2^i) == 1 by successive squaring
+        long i = 0;
+        for(uint64_t power = t; power != 1; power = mulMod(power, power, prime)) {
+            i++;
+        }
+
+        uint64_t b = c;
+        for(long j = 0; j < m - i - 1; ++j) {
+            b = mulMod(b, b, prime);
+        }
+        m = i;
+
+        c = mulMod(b, b, prime);
+        t = mulMod(t, c, prime);
+        r = mulMod(r, b, prime);
+    }
     return r;
 }
 
+uint64_t modInverse(const uint64_t number, const uint64_t modulus) {
+    // Extended Euclid, the coefficients are bounded by the modulus but need its sign as well
+    __int128 oldR = number % modulus, r = modulus;
+    __int128 oldS = 1, s = 0;
+    while(r != 0) {
+        const __int128 quotient = oldR / r;
+        oldR -= quotient * r;
+        std::swap(oldR, r);
+        oldS -= quotient * s;
+        std::swap(oldS, s);
+    }
+    if(oldR != 1) return 0;
+    return static_cast<uint64_t>(oldS < 0 ? oldS + modulus : oldS);
+}
+
+bool isPrime(const uint64_t number) {
+    // These bases are enough for every number below 3.3 * 10^24
+    constexpr uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if(number < 2) return false;
+    for(const uint64_t base : bases) {
+        if(number % base == 0) return number == base;
+    }
+
+    uint64_t q = number - 1;
+    int s = 0;
+    while(q % 2 == 0) {
+        q /= 2;
+        s++;
+    }
+
+    for(const uint64_t base : bases) {
+        uint64_t x = expMod(base, q, number);
+        if(x == 1 || x == number - 1) continue;
+
+        bool witness = true;
+        for(int i = 1; i < s && witness; ++i) {
+            x = mulMod(x, x, number);
+            witness = x != number - 1;
+        }
+        if(witness) return false;
+    }
+    return true;
+}
+
+bool isProbablePrime(const BigInt &number) {
+    if(number.getLimbs().size() <= 1) {
+        return number.isPositive() && isPrime(number.isZero() ? 0 : number.getLimbs()[0]);
+    }
+    if(number.isEven() || !number.isPositive()) return false;
+
+    BigInt q = number - 1;
+    int s = 0;
+    while(q.isEven()) {
+        q.divSmall(2);
+        s++;
+    }
+
+    Montgomery<BigInt> context(number);
+    const BigInt minusOne = number - 1;
+    for(const long long base : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+        BigInt x = context.exp(base, q);
+        if(x == 1 || x == minusOne) continue;
+
+        bool witness = true;
+        for(int i = 1; i < s && witness; ++i) {
+            x = context.multiplyMod(x, x);
+            witness = x != minusOne;
+        }
+        if(witness) return false;
+    }
+    return true;
+}
+
+uint64_t splitCofactor(const uint64_t number) {
+    assert(number < (1ULL << 63));
+    if(number % 2 == 0) return 2;
+
+    // Squares of primes would make every gcd either 1 or number
+    auto root = static_cast<uint64_t>(std::sqrt(static_cast<long double>(number)));
+    while(root * root > number) --root;
+    while((root + 1) * (root + 1) <= number) ++root;
+    if(root * root == number) return root;
+
+    constexpr uint64_t batchSize = 64;
+    for(uint64_t constant = 1; constant < 32; ++constant) {
+        const auto next = [number, constant](const uint64_t value) {
+            return (mulMod(value, value, number) + constant) % number;
+        };
+        const auto distance = [](const uint64_t lhs, const uint64_t rhs) {
+            return lhs > rhs ? lhs - rhs : rhs - lhs;
+        };
+
+        // x stays at the position of the last power of two, y runs ahead of it
+        uint64_t x = 2, y = 2, batchStart = 2, divisor = 1;
+        for(uint64_t length = 1; divisor == 1; length *= 2) {
+            x = y;
+            for(uint64_t i = 0; i < length && divisor == 1; i += batchSize) {
+                batchStart = y;
+                uint64_t product = 1;
+                for(uint64_t j = 0; j < batchSize && i + j < length; ++j) {
+                    y = next(y);
+                    product = mulMod(product, distance(x, y), number);
+                }
+                divisor = std::gcd(product, number);
+            }
+        }
+
+        if(divisor == number) {
+            // The batch went past the factor, repeat it one step at a time
+            y = batchStart;
+            do {
+                y = next(y);
+                divisor = std::gcd(distance(x, y), number);
+            } while(divisor == 1);
+        }
+
+        if(divisor != number) return divisor;
+    }
+    return 0;
+}
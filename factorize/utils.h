@@ -1,15 +1,88 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 #include "big_int.h"
 
 
-std::vector<BigInt> generatePrimes(long long limit);
-std::vector<BigInt> generateFactorBase(long long amount, const BigInt &number);
+/**
+ * Primes modulo which the number is a quadratic residue, with a square root of the number modulo
+ * every one of them. The roots stay the same for all polynomials, so they are computed once and
+ * shared by all polynomial generators.
+ */
+struct FactorBase {
+    std::vector<uint32_t> primes;
+    std::vector<uint32_t> numberRoots;
+};
+
+/**
+ * Passes all primes below limit to callback in increasing order. Uses a segmented sieve over odd
+ * numbers only, one bit each, with segments that fit into the L1 cache.
+ */
+void forEachPrime(uint64_t limit, const std::function<void(uint32_t)> &callback);
+
+/**
+ * @return All primes below limit, which can be at most 2^32
+ */
+std::vector<uint32_t> generatePrimes(uint64_t limit);
+FactorBase generateFactorBase(long long amount, const BigInt &number);
+
+/**
+ * Builds a factor base from primes that are already known to have number as a quadratic residue
+ */
+FactorBase buildFactorBase(const std::vector<BigInt> &primes, const BigInt &number);
 
 bool isQuadraticResidue(const BigInt& number, const BigInt& prime);
 
-// first 1000 primes
-inline std::vector<BigInt> primes1000 = generatePrimes(7920);
+/**
+ * Decides quadratic residuosity from the Jacobi symbol, without any exponentiation
+ */
+bool isQuadraticResidue(uint64_t number, uint64_t prime);
+
+// first 1000 primes, sieved at compile time. 7919 is the 1000th prime.
+constexpr std::array<uint32_t, 1000> primes1000 = [] {
+    constexpr uint32_t limit = 7920;
+    std::array<bool, limit> composite{};
+    std::array<uint32_t, 1000> primes{};
+    size_t count = 0;
+    for(uint32_t i = 2; i < limit; ++i) {
+        if(composite[i]) continue;
+        primes[count++] = i;
+        for(uint32_t j = i * i; j < limit; j += i) {
+            composite[j] = true;
+        }
+    }
+    return primes;
+}();
 
 BigInt tonelliShanks(const BigInt& number, const BigInt& prime);
+
+/**
+ * Same as the BigInt version, with 128 bit intermediates. number needs to be a quadratic residue
+ * modulo prime.
+ */
+uint64_t tonelliShanks(uint64_t number, uint64_t prime);
+
+/**
+ * @return 0 if number has no inverse
+ */
+uint64_t modInverse(uint64_t number, uint64_t modulus);
+
+/**
+ * Deterministic Miller-Rabin test for 64 bit numbers
+ */
+bool isPrime(uint64_t number);
+
+/**
+ * Miller-Rabin test with the first 12 primes as bases, which is deterministic below 3.3 * 10^24
+ */
+bool isProbablePrime(const BigInt &number);
+
+/**
+ * Finds a nontrivial factor of a composite 64 bit number below 2^63 with Pollard's rho method
+ * (Brent's variant, with the gcd taken over batches of steps).
+ * @return A factor in (1, number), or 0 if none was found
+ */
+uint64_t splitCofactor(uint64_t number);
@@ -2,6 +2,8 @@
 #include "big_int.h"
 #include "utils.h"
 
+#include <random>
+
 
 
 class BigIntTest : public testing::Test {
@@ -430,7 +432,7 @@ TEST_F(BigIntTest, expTest) {
 
 TEST_F(BigIntTest, modInverseTest) {
 
-    const std::vector<BigInt> primes = generatePrimes(1000);
+    const std::vector<uint32_t> primes = generatePrimes(1000);
 
     for(const auto &prime : primes) {
         for(int i = 1; i < static_cast<long long>(prime); ++i) {
@@ -439,6 +441,42 @@ TEST_F(BigIntTest, modInverseTest) {
         }
     }
 
+    // Multi limb moduli go through Lehmer steps
+    const BigInt modulus = BigInt("340282366920938463463374607431768211507") * BigInt(overflow);
+    for(const auto &num : {small, big, overflow, negOverflow, BigInt("98712398712938712983712937")}) {
+        if(BigInt::gcd(num, modulus) != 1) continue;
+        const BigInt inv = BigInt::modInverse(num, modulus);
+        ASSERT_TRUE(inv > 0 && inv < modulus);
+        ASSERT_EQ((num * inv) % modulus, 1);
+    }
+    ASSERT_EQ(BigInt::modInverse(big * 7, big * 13), 0);
+}
+
+TEST_F(BigIntTest, gcdTest) {
+    ASSERT_EQ(BigInt::gcd(zero, zero), 0);
+    ASSERT_EQ(BigInt::gcd(big, zero), big);
+    ASSERT_EQ(BigInt::gcd(zero, negative), 1234);
+    ASSERT_EQ(BigInt::gcd(small, negative), 1234);
+    ASSERT_EQ(BigInt::gcd(BigInt(48), BigInt(180)), 12);
+
+    // Compare with Euclid on random numbers of up to 6 limbs, with a common factor
+    std::mt19937_64 random(7);
+    for(int i = 0; i < 200; ++i) {
+        std::vector<Limb> factorLimbs(1 + i % 3), lhsLimbs(1 + i % 4), rhsLimbs(1 + (i / 4) % 4);
+        for(auto *limbs : {&factorLimbs, &lhsLimbs, &rhsLimbs}) {
+            for(auto &limb : *limbs) limb = random();
+        }
+        const BigInt factor = BigInt::fromLimbs(factorLimbs);
+        const BigInt lhs = BigInt::fromLimbs(lhsLimbs) * factor;
+        const BigInt rhs = BigInt::fromLimbs(rhsLimbs) * factor;
+
+        BigInt a = lhs, b = rhs;
+        while(b != 0) {
+            a = std::exchange(b, a % b);
+        }
+        ASSERT_EQ(BigInt::gcd(lhs, rhs), a);
+        ASSERT_EQ(BigInt::gcd(rhs, lhs), a);
+    }
 }
 
 TEST_F(BigIntTest, longCastTest) {
@@ -456,3 +494,67 @@ TEST_F(BigIntTest, longCastTest) {
     }
 }
 
+
+TEST_F(BigIntTest, limbTest) {
+
+    const BigInt twoPow64("18446744073709551616");
+    ASSERT_EQ(twoPow64.getLimbs().size(), 2);
+    ASSERT_EQ(twoPow64.getLimbs()[0], 0);
+    ASSERT_EQ(twoPow64.getLimbs()[1], 1);
+    ASSERT_EQ(twoPow64.bitLength(), 65);
+
+    BigInt res = twoPow64 - 1;
+    ASSERT_EQ(res.getLimbs().size(), 1);
+    ASSERT_EQ(res.getDigits(), "18446744073709551615");
+
+    res += 1;
+    ASSERT_EQ(res, twoPow64);
+
+    ASSERT_TRUE(BigInt(0).getLimbs().empty());
+    ASSERT_TRUE((negative - negative).isPositive());
+    ASSERT_EQ(BigInt::log2(twoPow64), 64);
+    ASSERT_EQ(BigInt::log2(res - 1), 63);
+}
+
+TEST_F(BigIntTest, divmodTest) {
+
+    auto [quotient, remainder] = BigInt::divmod(overflow, big);
+    ASSERT_EQ(quotient.getDigits(), "150218312599818042855580967753");
+    ASSERT_EQ(remainder.getDigits(), "11753410495");
+
+    // Truncating division, the remainder has the sign of the dividend
+    std::tie(quotient, remainder) = BigInt::divmod(BigInt(-123932), BigInt(221));
+    ASSERT_EQ(quotient, -560);
+    ASSERT_EQ(remainder, -172);
+
+    // Single limb divisor
+    std::tie(quotient, remainder) = BigInt::divmod(negOverflow, BigInt(1000003));
+    ASSERT_EQ(quotient * BigInt(1000003) + remainder, negOverflow);
+    ASSERT_EQ(remainder.getDigits(), "289882");
+    ASSERT_FALSE(remainder.isPositive());
+
+    // Needs the rarely taken add back step of algorithm D
+    const BigInt lhs = BigInt::fromLimbs(std::vector<Limb>{3, 0, 1ULL << 63});
+    const BigInt rhs = BigInt::fromLimbs(std::vector<Limb>{1, 0, 1ULL << 61});
+    std::tie(quotient, remainder) = BigInt::divmod(lhs, rhs);
+    ASSERT_EQ(quotient, 3);
+    ASSERT_EQ(remainder.getDigits(), "784637716923335095479473677900958302012794430558004314112");
+}
+
+TEST_F(BigIntTest, smallDivisorTest) {
+
+    for(const auto &num : {small, big, overflow, negOverflow, negative, bigNegative, zero}) {
+        for(const Limb divisor : {1ULL, 2ULL, 3ULL, 7919ULL, 1000003ULL, 18446744073709551557ULL}) {
+            const BigInt bigDivisor = BigInt::fromLimbs(std::vector<Limb>{divisor});
+            const LimbDivisor precomputed(divisor);
+
+            ASSERT_EQ(BigInt::fromLimbs(std::vector<Limb>{num.modSmall(divisor)}), num % bigDivisor);
+            ASSERT_EQ(num.modSmall(precomputed), num.modSmall(divisor));
+
+            BigInt quotient = num;
+            const Limb remainder = quotient.divSmall(precomputed);
+            ASSERT_EQ(quotient, num / bigDivisor);
+            ASSERT_EQ(BigInt::fromLimbs(std::vector<Limb>{remainder}), BigInt::abs(BigInt::divmod(num, bigDivisor).second));
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+#include "block_lanczos.h"
+
+#include <random>
+
+
+/**
+ * Exponent vectors that look like those of relations: prime i divides a relation with
+ * probability of about 2/p_i, so the first rows are dense and the others sparse
+ */
+std::vector<std::vector<int>> randomExponents(const int relations, const int primes, std::mt19937 &random) {
+    std::vector<std::vector<int>> exponents(relations, std::vector<int>(primes));
+    std::uniform_real_distribution<double> distribution(0, 1);
+    for(auto &relation : exponents) {
+        for(int i = 0; i < primes; ++i) {
+            if(distribution(random) < 2.0 / (10 * (i + 1))) {
+                relation[i] = 1 + static_cast<int>(distribution(random) * 3);
+            }
+        }
+    }
+    return exponents;
+}
+
+void checkDependencies(const std::vector<std::set<int>> &dependencies, const std::vector<std::vector<int>> &exponents) {
+    for(const auto &dependency : dependencies) {
+        ASSERT_FALSE(dependency.empty());
+        std::vector<int> sum(exponents[0].size());
+        for(const int i : dependency) {
+            for(int j = 0; j < sum.size(); ++j) {
+                sum[j] += exponents[i][j];
+            }
+        }
+        for(const int exponent : sum) {
+            ASSERT_EQ(exponent % 2, 0);
+        }
+    }
+}
+
+TEST(BlockLanczosTest, buildSparseMatrixTest) {
+    const std::vector<std::vector<int>> exponents = {
+        {1, 2, 3},
+        {0, 0, 0},
+        {4, 1, 1},
+    };
+
+    const SparseMatrix matrix = buildSparseMatrix(exponents);
+    ASSERT_EQ(matrix.rowCount, 3);
+    ASSERT_EQ(matrix.columnCount(), 3);
+    ASSERT_EQ(matrix.columnStarts, std::vector<uint32_t>({0, 2, 2, 4}));
+    ASSERT_EQ(matrix.rows, std::vector<uint32_t>({0, 2, 1, 2}));
+}
+
+TEST(BlockLanczosTest, nullSpaceTest) {
+    std::mt19937 random(42);
+    const auto exponents = randomExponents(3000, 2800, random);
+
+    const auto dependencies = blockLanczos(buildSparseMatrix(exponents));
+    ASSERT_GE(dependencies.size(), 32);
+    checkDependencies(dependencies, exponents);
+
+    // The products are split over threads, the result must not change
+    ASSERT_EQ(blockLanczos(buildSparseMatrix(exponents), 3), dependencies);
+}
+
+TEST(BlockLanczosTest, squareRelationTest) {
+    std::mt19937 random(7);
+    auto exponents = randomExponents(3000, 2800, random);
+    // No relation is a square, apart from two that are dependencies on their own
+    for(int i = 0; i < exponents.size(); ++i) {
+        for(auto &exponent : exponents[i]) {
+            if(exponent != 0) exponent |= 1;
+        }
+        exponents[i][i % 100] = 1;
+    }
+    for(const int square : {5, 1234}) {
+        for(auto &exponent : exponents[square]) {
+            exponent *= 2;
+        }
+    }
+
+    const auto dependencies = blockLanczos(buildSparseMatrix(exponents), 2);
+    checkDependencies(dependencies, exponents);
+    ASSERT_GE(dependencies.size(), 32);
+    ASSERT_EQ(dependencies[0], std::set<int>{5});
+    ASSERT_EQ(dependencies[1], std::set<int>{1234});
+}
@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+#include "fixed_int.h"
+
+
+TEST(FixedIntTest, constructorTest) {
+
+    const FixedInt<4> zero;
+    ASSERT_TRUE(zero.isPositive());
+    ASSERT_TRUE(zero.isZero());
+    ASSERT_EQ(zero.getDigits(), "0");
+
+    const FixedInt<4> negative("-1928371982738917238712323123123124556756");
+    ASSERT_FALSE(negative.isPositive());
+    ASSERT_EQ(negative.getDigits(), "1928371982738917238712323123123124556756");
+
+    const FixedInt<4> fromLong(-183812398129);
+    ASSERT_FALSE(fromLong.isPositive());
+    ASSERT_EQ(static_cast<long long>(fromLong), -183812398129);
+
+    const BigInt big("-987982734987234792749827394872938479143234");
+    ASSERT_EQ(static_cast<BigInt>(FixedInt<4>(big)), big);
+}
+
+TEST(FixedIntTest, arithmeticTest) {
+
+    // Compare every operation against BigInt, including carries over limb boundaries
+    const std::vector<std::string> numbers = {
+        "0", "1", "-1", "1234", "-12837129837", "18446744073709551615", "18446744073709551616",
+        "-340282366920938463463374607431768211455", "1928371982738917238712323123123124556756",
+    };
+
+    for(const auto &lhsDigits : numbers) {
+        for(const auto &rhsDigits : numbers) {
+            const BigInt lhs(lhsDigits), rhs(rhsDigits);
+            const FixedInt<8> fixedLhs(lhsDigits), fixedRhs(rhsDigits);
+
+            ASSERT_EQ(static_cast<BigInt>(fixedLhs + fixedRhs), lhs + rhs);
+            ASSERT_EQ(static_cast<BigInt>(fixedLhs - fixedRhs), lhs - rhs);
+            ASSERT_EQ(static_cast<BigInt>(fixedLhs * fixedRhs), lhs * rhs);
+            ASSERT_EQ(fixedLhs < fixedRhs, lhs < rhs);
+            ASSERT_EQ(fixedLhs == fixedRhs, lhs == rhs);
+
+            if(rhs == 0) continue;
+            ASSERT_EQ(static_cast<BigInt>(fixedLhs / fixedRhs), lhs / rhs);
+            ASSERT_EQ(static_cast<BigInt>(fixedLhs % fixedRhs), lhs % rhs);
+        }
+    }
+}
+
+TEST(FixedIntTest, numberTheoryTest) {
+
+    const FixedInt<4> modulus("10888869450418352160768000001");
+
+    ASSERT_EQ(FixedInt<4>::exp(182, FixedInt<4>("912392"), modulus).getDigits(),
+              "1412547413236019664049634774");
+    ASSERT_EQ(FixedInt<4>::sqrt(FixedInt<4>("1928371982738917238712323123123124556756")).getDigits(),
+              "43913232433275932081");
+    ASSERT_EQ(FixedInt<4>::ceilSqrt(FixedInt<4>("12312312319384")).getDigits(), "3508891");
+    ASSERT_EQ(FixedInt<4>::gcd(FixedInt<4>(123123123) * 97, FixedInt<4>(123123123) * 89), 123123123);
+
+    for(long long i = 1; i < 1000; ++i) {
+        const FixedInt<4> inv = FixedInt<4>::modInverse(i, 1009);
+        ASSERT_EQ((inv * i) % 1009, 1);
+    }
+
+    const BigInt lhs("1928371982738917238712323123123124556756"), rhs("98712398712938712983712937");
+    ASSERT_EQ(static_cast<BigInt>(FixedInt<8>::gcd(FixedInt<8>(lhs * rhs), FixedInt<8>(rhs * rhs))),
+              BigInt::gcd(lhs * rhs, rhs * rhs));
+    const BigInt inverse = static_cast<BigInt>(FixedInt<8>::modInverse(FixedInt<8>(rhs), FixedInt<8>(lhs)));
+    ASSERT_EQ(inverse, BigInt::modInverse(rhs, lhs));
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+#include "montgomery.h"
+#include "big_int.h"
+#include "fixed_int.h"
+#include "factorize.h"
+
+
+TEST(MontgomeryTest, multiplyTest) {
+
+    const BigInt modulus("10888869450418352160768000001");
+    Montgomery<BigInt> context(modulus);
+
+    const BigInt lhs("1928371982738917238712");
+    const BigInt rhs("-987982734987234792749");
+
+    ASSERT_EQ(context.fromMontgomery(context.toMontgomery(lhs)), lhs);
+    ASSERT_EQ(context.fromMontgomery(context.one()), 1);
+    ASSERT_EQ(context.multiplyMod(lhs, rhs), (lhs * rhs) % modulus);
+
+    const BigInt product = context.multiply(context.toMontgomery(lhs), context.toMontgomery(rhs));
+    ASSERT_EQ(context.fromMontgomery(product), (lhs * rhs) % modulus);
+}
+
+TEST(MontgomeryTest, expTest) {
+
+    // Multi limb modulus, so that the reduction carries between limbs
+    const BigInt modulus("340282366920938463463374607431768211507");
+    Montgomery<BigInt> context(modulus);
+    Montgomery<FixedInt<4>> fixedContext{FixedInt<4>(modulus)};
+
+    BigInt expected = 1;
+    const BigInt base("123456789123456789123456789");
+    for(long long exponent = 0; exponent < 300; ++exponent) {
+        ASSERT_EQ(context.exp(base, exponent), expected);
+        ASSERT_EQ(static_cast<BigInt>(fixedContext.exp(FixedInt<4>(base), exponent)), expected);
+        expected = (expected * base) % modulus;
+    }
+
+    // Fermat's little theorem for a large exponent
+    ASSERT_EQ(context.exp(base, modulus - 1), 1);
+}
+
+TEST(MontgomeryTest, pollardRhoTest) {
+
+    const Number number(BigInt(15755393) * BigInt("265042838657"));
+    const Number result = pollardRho(number);
+
+    ASSERT_EQ(result.getFactors(), std::multiset<BigInt>({15755393, BigInt("265042838657")}));
+    ASSERT_EQ(result.getCurrentValue(), 1);
+
+    // Repeated factors, and more than two of them
+    const BigInt composite = BigInt(1000003) * BigInt(1000003) * BigInt(4) * BigInt("3000000000001091") * BigInt(101);
+    const Number factored = pollardRho(Number(composite));
+    ASSERT_EQ(factored.getFactors(), std::multiset<BigInt>({2, 2, 101, 1000003, 1000003, BigInt("3000000000001091")}));
+    ASSERT_EQ(factored.getCurrentValue(), 1);
+}
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "poly_generator.h"
+#include "polynomial_scheduler.h"
+#include "fixed_int.h"
 
 #include "utils.h"
 
@@ -7,7 +9,7 @@ TEST(PolyGeneratorTest, basic) {
     const auto number = BigInt(291);
     const std::vector<BigInt> basePrimes = {5, 7, 11};
 
-    PolyGenerator generator(number, basePrimes, basePrimes);
+    PolyGenerator generator(number, basePrimes, std::make_shared<const FactorBase>(buildFactorBase(basePrimes, number)));
 
     std::vector<Polynomial> res;
     while(generator.hasNext()) {
@@ -41,16 +43,19 @@ TEST(PolyGeneratorTest, findSolutionTest) {
     }
 
 
-    PolyGenerator generator(number, basePrimes, factorBase);
+    PolyGenerator generator(number, basePrimes, std::make_shared<const FactorBase>(buildFactorBase(factorBase, number)));
 
-    std::vector<std::pair<BigInt, BigInt>> lastSolutions(factorBase.size(), {-1, -1});
+    PolynomialSolutions solutions;
 
     while(generator.hasNext()) {
         auto polynomial = generator.next();
         ASSERT_EQ(polynomial.a, 212135);
         BigInt b = polynomial.b;
 
-        auto nextSolutions = generator.findSolutions(lastSolutions, polynomial);
+        // Solved from scratch for the first polynomial and updated in place afterwards
+        generator.findSolutions(solutions, polynomial);
+        ASSERT_EQ(solutions.first.size(), factorBase.size());
+        ASSERT_EQ(solutions.second.size(), factorBase.size());
 
         for(int i = 0; i < factorBase.size(); i++) {
 
@@ -67,18 +72,102 @@ TEST(PolyGeneratorTest, findSolutionTest) {
             ASSERT_EQ(polynomial(solI) % factorBase[i], 0);
             ASSERT_EQ(polynomial(sol2) % factorBase[i], 0);
 
-            if(lastSolutions[i].first == -1) {
-                lastSolutions[i].first = solI;
-                lastSolutions[i].second = sol2;
-                continue;
-            }
-
-            ASSERT_EQ(nextSolutions[i].first, solI);
-            ASSERT_EQ(nextSolutions[i].second, sol2);
-            ASSERT_EQ(polynomial(nextSolutions[i].first) % factorBase[i], 0);
-            ASSERT_EQ(polynomial(nextSolutions[i].second) % factorBase[i], 0);
-            lastSolutions[i] = {solI, sol2};
+            ASSERT_EQ(BigInt(solutions.first[i]), solI);
+            ASSERT_EQ(BigInt(solutions.second[i]), sol2);
         }
     }
 
-}
\ No newline at end of file
+}
+
+TEST(PolyGeneratorTest, basePrimeSolutionsTest) {
+    const auto number = BigInt(291);
+    const std::vector<BigInt> basePrimes = {5, 7, 11};
+    const std::vector<BigInt> factorBase = {5, 7, 11, 17};
+
+    PolyGenerator generator(number, basePrimes, std::make_shared<const FactorBase>(buildFactorBase(factorBase, number)));
+    PolynomialSolutions solutions;
+    while(generator.hasNext()) {
+        const auto polynomial = generator.next();
+        generator.findSolutions(solutions, polynomial);
+        for(int i = 0; i < 3; i++) {
+            ASSERT_EQ(solutions.first[i], static_cast<long long>(factorBase[i]));
+            ASSERT_EQ(solutions.second[i], static_cast<long long>(factorBase[i]));
+        }
+        ASSERT_EQ(polynomial(BigInt(solutions.first[3])) % 17, 0);
+        ASSERT_EQ(polynomial(BigInt(solutions.second[3])) % 17, 0);
+    }
+}
+
+TEST(PolyGeneratorTest, fixedIntTest) {
+    const auto number = FixedInt<4>(291);
+    const std::vector<FixedInt<4>> basePrimes = {5, 7, 11};
+
+    const auto factorBase = std::make_shared<const FactorBase>(buildFactorBase({5, 7, 11}, BigInt(291)));
+    BasicPolyGenerator<FixedInt<4>> generator(number, basePrimes, factorBase);
+
+    std::vector<BasicPolynomial<FixedInt<4>>> res;
+    while(generator.hasNext()) {
+        res.emplace_back(generator.next());
+    }
+
+    ASSERT_EQ(res.size(), 4);
+    ASSERT_EQ(res[0].b, 334);
+    ASSERT_EQ(res[1].b, 26);
+    ASSERT_EQ(res[2].b, -194);
+    ASSERT_EQ(res[3].b, 114);
+}
+
+TEST(PolyGeneratorTest, seekTest) {
+    const auto number = BigInt(291);
+    const std::vector<BigInt> basePrimes = {5, 7, 11, 19, 29};
+    const std::vector<BigInt> factorBase = {17, 41, 47, 61, 67, 73};
+
+    PolyGenerator generator(number, basePrimes, std::make_shared<const FactorBase>(buildFactorBase(factorBase, number)));
+    const PolyGenerator start = generator;
+    ASSERT_EQ(generator.polynomialCount(), 16);
+
+    PolynomialSolutions solutions;
+    for(long long i = 0; generator.hasNext(); ++i) {
+        const auto polynomial = generator.next();
+        generator.findSolutions(solutions, polynomial);
+
+        PolyGenerator seeked = start;
+        seeked.seek(i);
+        const auto seekedPolynomial = seeked.next();
+        ASSERT_EQ(seekedPolynomial.a, polynomial.a);
+        ASSERT_EQ(seekedPolynomial.b, polynomial.b);
+        PolynomialSolutions seekedSolutions;
+        seeked.findSolutions(seekedSolutions, seekedPolynomial);
+        ASSERT_EQ(seekedSolutions.first, solutions.first);
+        ASSERT_EQ(seekedSolutions.second, solutions.second);
+    }
+}
+
+TEST(PolyGeneratorTest, schedulerTest) {
+    const auto number = BigInt(291);
+    const std::vector<BigInt> basePrimes = {5, 7, 11, 19, 29};
+    const auto factorBase = std::make_shared<const FactorBase>(buildFactorBase({17, 41, 47, 61, 67, 73}, number));
+
+    int families = 0;
+    PolynomialScheduler<BigInt> scheduler(2, 3, [&]() {
+        families++;
+        return std::make_shared<const PolyGenerator>(number, basePrimes, factorBase);
+    });
+
+    // Worker 0 creates the family of 16 polynomials and takes chunks from the front, worker 1
+    // steals from the back
+    std::vector<std::pair<long long, long long>> chunks;
+    for(int i = 0; i < 6; ++i) {
+        const auto chunk = scheduler.next(i % 2);
+        ASSERT_EQ(families, 1);
+        chunks.emplace_back(chunk.begin, chunk.end);
+    }
+    const std::vector<std::pair<long long, long long>> expected = {
+        {0, 3}, {13, 16}, {3, 6}, {10, 13}, {6, 9}, {9, 10}
+    };
+    ASSERT_EQ(chunks, expected);
+
+    // The family is used up
+    scheduler.next(1);
+    ASSERT_EQ(families, 2);
+}
@@ -1,7 +1,11 @@
 #include "gtest/gtest.h"
 #include "quadratic_sieve.h"
+#include "poly_generator.h"
+#include "relation_collector.h"
 #include "utils.h"
 
+#include <thread>
+
 
 TEST(QuadraticSieveTest, isQuadraticResidueTest) {
 
@@ -44,6 +48,49 @@ TEST(QuadraticSieveTest, tonelliShanksTest) {
 
 }
 
+TEST(QuadraticSieveTest, wordSizedTonelliShanksTest) {
+    // Same roots as the BigInt version
+    ASSERT_EQ(tonelliShanks(uint64_t(5), uint64_t(41)), 28);
+    ASSERT_EQ(tonelliShanks(uint64_t(11), uint64_t(19)), 7);
+    ASSERT_EQ(tonelliShanks(uint64_t(19641285), uint64_t(39916801)), 231232);
+    ASSERT_EQ(tonelliShanks(uint64_t(14491491703446199), uint64_t(99194853094755497)), 1283182731827323);
+
+    // The largest 64 bit prime, 2^64 - 59, needs the full 128 bit products
+    const uint64_t prime = 18446744073709551557ULL;
+    for(uint64_t number = 2; number < 200; ++number) {
+        const bool residue = BigInt::exp(static_cast<long long>(number), BigInt("9223372036854775778"),
+                                         BigInt("18446744073709551557")) == 1;
+        ASSERT_EQ(isQuadraticResidue(number, prime), residue);
+        if(!residue) continue;
+
+        const uint64_t root = tonelliShanks(number, prime);
+        ASSERT_EQ(static_cast<unsigned __int128>(root) * root % prime, number);
+    }
+
+    for(const uint64_t modulus : {uint64_t(41), uint64_t(1000000007), prime}) {
+        for(uint64_t number = 1; number < 41; ++number) {
+            const uint64_t inverse = modInverse(number, modulus);
+            ASSERT_EQ(static_cast<unsigned __int128>(inverse) * number % modulus, 1);
+        }
+    }
+    ASSERT_EQ(modInverse(6, 9), 0);
+}
+
+TEST(QuadraticSieveTest, generateFactorBaseTest) {
+    const BigInt number("4175854084876627201");
+    const FactorBase factorBase = generateFactorBase(500, number);
+    ASSERT_FALSE(factorBase.primes.empty());
+    ASSERT_EQ(factorBase.numberRoots.size(), factorBase.primes.size());
+
+    for(int i = 0; i < factorBase.primes.size(); i++) {
+        const uint64_t prime = factorBase.primes[i];
+        const uint64_t root = factorBase.numberRoots[i];
+        ASSERT_TRUE(isPrime(prime));
+        ASSERT_LT(root, prime);
+        ASSERT_EQ(root * root % prime, number.modSmall(prime));
+    }
+}
+
 TEST(QuadraticSieveTest, computeFactorsTest) {
     const std::vector<BigInt> factorBase = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29};
 
@@ -121,3 +168,377 @@ TEST(QuadraticSieveTest, computeLinearDependencyTest) {
     }
 }
 
+
+TEST(QuadraticSieveTest, computeNullSpaceTest) {
+    // 70 unit vectors, followed by the sums of neighbouring unit vectors, so the rows span
+    // several words and the null space has dimension 60
+    const int columns = 70;
+    std::vector<std::vector<int>> factorizationExponents;
+    for(int i = 0; i < columns; ++i) {
+        factorizationExponents.emplace_back(columns);
+        factorizationExponents.back()[i] = 1;
+    }
+    for(int i = 0; i + 10 < columns; ++i) {
+        factorizationExponents.emplace_back(columns);
+        factorizationExponents.back()[i] = 3;
+        factorizationExponents.back()[i + 1] = 1;
+    }
+
+    const auto dependencies = computeNullSpace(factorizationExponents);
+    ASSERT_EQ(dependencies.size(), 60);
+
+    std::set<std::set<int>> distinct;
+    for(const auto &dependency : dependencies) {
+        ASSERT_FALSE(dependency.empty());
+        std::vector<int> sum(columns);
+        for(const int i : dependency) {
+            for(int j = 0; j < columns; ++j) {
+                sum[j] += factorizationExponents[i][j];
+            }
+        }
+        for(const int exponent : sum) {
+            ASSERT_EQ(exponent % 2, 0);
+        }
+        distinct.insert(dependency);
+    }
+    ASSERT_EQ(distinct.size(), dependencies.size());
+}
+
+
+TEST(QuadraticSieveTest, sievePolynomialTest) {
+    const BigInt number("4175854084876627201");
+    // Large enough for the upper part of the factor base to be bucket sieved
+    const auto sharedFactorBase = std::make_shared<const FactorBase>(generateFactorBase(8000, number));
+    const std::vector<BigInt> factorBase(sharedFactorBase->primes.begin(), sharedFactorBase->primes.end());
+    ASSERT_GE(factorBase.back(), bucketSieveThreshold);
+    const std::vector<uint8_t> primeLogs = computePrimeLogs(factorBase);
+
+    // The interval spans several blocks
+    const long long sieveRange = 2 * sieveBlockSize;
+    const std::vector<BigInt> basePrimes = selectBasePrimes(number, factorBase, sieveRange);
+    ASSERT_FALSE(basePrimes.empty());
+
+    PolyGenerator generator(number, basePrimes, sharedFactorBase);
+    const Polynomial polynomial = generator.next();
+    PolynomialSolutions solutions;
+    generator.findSolutions(solutions, polynomial);
+
+    const long long largePrimeBound = 64 * static_cast<long long>(factorBase.back());
+    const long long doubleLargePrimeBound = largePrimeBound * static_cast<long long>(factorBase.back());
+    const auto relations = sievePolynomial(polynomial, solutions, factorBase, primeLogs, sieveRange,
+                                           largePrimeBound, doubleLargePrimeBound);
+    ASSERT_FALSE(relations.empty());
+
+    bool hasLargePrime = false;
+    for(const auto &relation : relations) {
+        ASSERT_EQ(relation.x*relation.x - number, relation.y);
+
+        // The attached factors are exactly the factorization of y, apart from the large prime
+        BigInt smoothPart = relation.y;
+        for(const long long prime : relation.largePrimes) {
+            ASSERT_LT(prime, largePrimeBound);
+            if(prime == 1) continue;
+            ASSERT_TRUE(isPrime(prime));
+            ASSERT_GT(BigInt(prime), factorBase.back());
+            ASSERT_EQ(smoothPart.divSmall(prime), 0);
+        }
+        const auto exponents = computeFactors(smoothPart, factorBase);
+        std::vector<int> attached(factorBase.size());
+        for(const int index : relation.factors) {
+            attached[index]++;
+            if(factorBase[index] >= bucketSieveThreshold) hasLargePrime = true;
+        }
+        ASSERT_EQ(attached, exponents);
+    }
+    ASSERT_TRUE(hasLargePrime);
+}
+
+TEST(QuadraticSieveTest, scanSieveTest) {
+    std::vector<uint8_t> sieve(1001);
+    for(int i = 0; i < sieve.size(); ++i) {
+        sieve[i] = static_cast<uint8_t>((i * 37 + i / 7) % 256);
+    }
+
+    for(const int threshold : {0, 1, 100, 200, 255}) {
+        std::vector<long long> expected;
+        for(int i = 3; i < sieve.size(); ++i) {
+            if(sieve[i] >= threshold) expected.push_back(i + 50);
+        }
+
+        std::vector<long long> candidates;
+        scanSieve(sieve.data() + 3, sieve.size() - 3, threshold, 53, candidates);
+        ASSERT_EQ(candidates, expected);
+    }
+}
+
+TEST(QuadraticSieveTest, computeCutoffsTest) {
+    const long long sieveRange = 1000;
+    const long long rootBits = 40;
+    const auto cutoffs = computeCutoffs(sieveRange, rootBits);
+
+    ASSERT_EQ(cutoffs.front().first, 0);
+    for(int piece = 0; piece < cutoffs.size(); ++piece) {
+        const long long end = piece + 1 < cutoffs.size() ? cutoffs[piece + 1].first : 2 * sieveRange + 1;
+        ASSERT_LT(cutoffs[piece].first, end);
+        for(long long i = cutoffs[piece].first; i < end; ++i) {
+            const long long x = i - sieveRange;
+            const long long expected = x == 0 ? 0 : (63 - __builtin_clzll(std::abs(x)) + rootBits) * 2 / 3;
+            ASSERT_EQ(cutoffs[piece].second, expected);
+        }
+    }
+}
+
+TEST(QuadraticSieveTest, combineRelationsTest) {
+    const BigInt number("4175854084876627201");
+    const std::vector<BigInt> factorBase = {2, 5, 7, 11};
+    const long long largePrime = 1000003;
+
+    // x^2 = y (mod number) with y = 2 * 5 * 7^2 * largePrime and y = 5 * 11 * largePrime
+    Relation<BigInt> lhs{BigInt(0), BigInt(2 * 5 * 7 * 7) * BigInt(largePrime), {0, 1, 2, 2}, {1, largePrime}};
+    Relation<BigInt> rhs{BigInt(0), BigInt(5 * 11) * BigInt(largePrime), {1, 3}, {1, largePrime}};
+    // Fake the x values from square roots, number is a product of two primes 3 mod 4
+    const BigInt p("15755393"), q("265042838657");
+    ASSERT_EQ(p * q, number);
+    for(auto *relation : {&lhs, &rhs}) {
+        const BigInt rootP = tonelliShanks(relation->y % p, p);
+        const BigInt rootQ = tonelliShanks(relation->y % q, q);
+        ASSERT_GE(rootP, 0);
+        ASSERT_GE(rootQ, 0);
+        // Chinese remainder theorem
+        relation->x = (rootP + p * ((rootQ - rootP) * BigInt::modInverse(p % q, q) % q)) % number;
+        ASSERT_EQ(relation->x * relation->x % number, relation->y % number);
+    }
+
+    const auto combined = combineRelations<BigInt>({lhs, rhs}, number);
+    ASSERT_EQ(combined.largePrimes[1], 1);
+    ASSERT_EQ(combined.y, BigInt(2 * 5 * 5 * 7 * 7 * 11));
+    ASSERT_EQ(combined.x * combined.x % number, combined.y % number);
+
+    std::vector<int> exponents(factorBase.size());
+    for(const int index : combined.factors) {
+        exponents[index]++;
+    }
+    ASSERT_EQ(exponents, computeFactors(combined.y, factorBase));
+}
+
+TEST(QuadraticSieveTest, filterRelationsTest) {
+    const BigInt number(1000003);
+    // Only the factors matter, x tells duplicates apart
+    const auto relation = [](const long long x, std::vector<int> factors) {
+        return Relation<BigInt>{BigInt(x), BigInt(0), std::move(factors)};
+    };
+
+    std::vector<Relation<BigInt>> relations = {
+        relation(1, {0, 1}),
+        relation(2, {1, 2}),
+        relation(3, {0, 2}),
+        // Only odd power of prime 3
+        relation(4, {3, 0, 0}),
+        // A square on its own
+        relation(5, {4, 4}),
+        // Duplicate of the first relation
+        relation(1000004, {0, 1}),
+        // Prime 5 is a singleton, after removing this relation prime 6 is one as well
+        relation(6, {5, 6}),
+        relation(7, {6, 1, 2}),
+    };
+
+    auto filtered = filterRelations(relations, number, 7);
+    std::vector<BigInt> xValues;
+    for(const auto &filteredRelation : filtered) {
+        xValues.emplace_back(filteredRelation.x);
+    }
+    ASSERT_EQ(xValues, std::vector<BigInt>({1, 2, 3, 5}));
+
+    // With 3 primes and 2 relations of excess, 4 of 9 relations need to go. The heaviest ones
+    // first, which leaves a singleton behind.
+    relations = {
+        relation(1, {0}), relation(2, {0}), relation(3, {1}), relation(4, {1}), relation(5, {2}),
+        relation(6, {2}), relation(7, {0, 1}), relation(8, {1, 2}), relation(9, {0, 2}),
+    };
+    filtered = filterRelations(relations, number, 3, 2);
+    ASSERT_EQ(filtered.size(), 4);
+
+    std::vector<int> weights(3);
+    for(const auto &filteredRelation : filtered) {
+        ASSERT_EQ(filteredRelation.factors.size(), 1);
+        weights[filteredRelation.factors[0]]++;
+    }
+    for(const int weight : weights) {
+        ASSERT_NE(weight, 1);
+    }
+}
+
+TEST(QuadraticSieveTest, isPrimeTest) {
+    const auto primes = generatePrimes(10000);
+    std::vector<bool> expected(10000);
+    for(const auto &prime : primes) {
+        expected[static_cast<long long>(prime)] = true;
+    }
+    for(uint64_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(isPrime(i), expected[i]);
+    }
+
+    ASSERT_TRUE(isPrime(265042838657ULL));
+    ASSERT_TRUE(isPrime(18446744073709551557ULL));
+    ASSERT_FALSE(isPrime(4175854084876627201ULL));
+    // Strong pseudoprime to the bases 2 to 37 except 37
+    ASSERT_FALSE(isPrime(3825123056546413051ULL));
+
+    ASSERT_TRUE(isProbablePrime(BigInt(7919)));
+    ASSERT_FALSE(isProbablePrime(BigInt(-7919)));
+    ASSERT_TRUE(isProbablePrime(BigInt("340282366920938463463374607431768211507")));
+    ASSERT_FALSE(isProbablePrime(BigInt("340282366920938463463374607431768211507") * BigInt(1000003)));
+    ASSERT_FALSE(isProbablePrime(BigInt("18446744073709551557") * BigInt("18446744073709551557")));
+}
+
+TEST(QuadraticSieveTest, generatePrimesTest) {
+    ASSERT_TRUE(generatePrimes(0).empty());
+    ASSERT_TRUE(generatePrimes(2).empty());
+    ASSERT_EQ(generatePrimes(3), std::vector<uint32_t>{2});
+    ASSERT_EQ(generatePrimes(12), (std::vector<uint32_t>{2, 3, 5, 7, 11}));
+    ASSERT_EQ(generatePrimes(7920).size(), 1000);
+
+    // The compile time table agrees with the sieve
+    static_assert(primes1000[999] == 7919);
+    const std::vector<uint32_t> small = generatePrimes(7920);
+    ASSERT_TRUE(std::equal(primes1000.begin(), primes1000.end(), small.begin(), small.end()));
+
+    // Spans several segments, the last one partially
+    const uint64_t limit = 1100000;
+    std::vector<uint32_t> streamed;
+    forEachPrime(limit, [&streamed](const uint32_t prime) {
+        streamed.push_back(prime);
+    });
+    ASSERT_EQ(streamed, generatePrimes(limit));
+    ASSERT_EQ(streamed.size(), 85714);
+
+    size_t next = 0;
+    for(uint64_t i = 0; i < limit; ++i) {
+        if(isPrime(i)) {
+            ASSERT_EQ(streamed[next], i);
+            next++;
+        }
+    }
+    ASSERT_EQ(next, streamed.size());
+}
+
+TEST(QuadraticSieveTest, splitCofactorTest) {
+    const std::vector<std::pair<uint64_t, uint64_t>> cofactors = {
+        {15755393, 265042838657}, {1000003, 1000033}, {1000003, 1000003}, {3, 1000000007},
+        {2147483647, 2147483659}
+    };
+    for(const auto &[p, q] : cofactors) {
+        const uint64_t factor = splitCofactor(p * q);
+        ASSERT_TRUE(factor == p || factor == q);
+    }
+}
+
+TEST(QuadraticSieveTest, relationCollectorTest) {
+    const BigInt number("4175854084876627201");
+    const long long largePrime = 1000003;
+    // Only x and y tell relations apart, the collector does not look at the factors
+    const auto relation = [](const long long x, const std::array<long long, 2> largePrimes) {
+        return Relation<BigInt>{BigInt(x), BigInt(x) * BigInt(x), {0}, largePrimes};
+    };
+
+    // Every thread adds the same 40 full relations and the same two partial relations with a
+    // common large prime, in batches of 5
+    const auto addAll = [&](RelationCollector<BigInt> &collector) {
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t) {
+            threads.emplace_back([&collector, &relation, t, largePrime]() {
+                for(int batch = 0; batch < 8; ++batch) {
+                    std::vector<Relation<BigInt>> relations;
+                    for(int i = 0; i < 5; ++i) {
+                        relations.emplace_back(relation(2 + 5 * ((batch + 2 * t) % 8) + i, {1, 1}));
+                    }
+                    if(batch == t) {
+                        relations.emplace_back(relation(1000, {1, largePrime}));
+                        relations.emplace_back(relation(1001, {1, largePrime}));
+                    }
+                    collector.add(std::move(relations));
+                }
+            });
+        }
+        for(auto &thread : threads) {
+            thread.join();
+        }
+    };
+
+    RelationCollector<BigInt> collector(number, 1000);
+    addAll(collector);
+    ASSERT_FALSE(collector.isDone());
+
+    // The duplicates are gone, the partial relations were combined in the graph
+    const auto relations = collector.takeRelations();
+    ASSERT_EQ(relations.size(), 41);
+    std::set<BigInt> xValues;
+    for(const auto &full : relations) {
+        ASSERT_EQ(full.largePrimes[1], 1);
+        xValues.insert(full.x);
+    }
+    ASSERT_EQ(xValues.size(), 41);
+    const BigInt combinedX = BigInt(1000) * BigInt(1001) * BigInt::modInverse(largePrime, number) % number;
+    ASSERT_TRUE(xValues.contains(combinedX));
+
+    // Collecting stops once the target is passed, batches added afterwards are ignored
+    RelationCollector<BigInt> limited(number, 20);
+    addAll(limited);
+    ASSERT_TRUE(limited.isDone());
+    const size_t collected = limited.takeRelations().size();
+    ASSERT_GT(collected, 20);
+    ASSERT_LE(collected, 20 + 7);
+
+    // Collecting again only counts relations that were not seen before
+    limited.collectMore(2);
+    ASSERT_FALSE(limited.isDone());
+    limited.add({relation(100, {1, 1}), relation(100, {1, 1}), relation(101, {1, 1})});
+    ASSERT_FALSE(limited.isDone());
+    limited.add({relation(101, {1, 1}), relation(102, {1, 1})});
+    ASSERT_TRUE(limited.isDone());
+    ASSERT_EQ(limited.takeRelations().size(), 3);
+}
+
+TEST(QuadraticSieveTest, findSquareFactorTest) {
+    const BigInt p("15755393"), q("265042838657");
+    const BigInt number = p * q;
+    const auto sharedFactorBase = std::make_shared<const FactorBase>(generateFactorBase(200, number));
+    const std::vector<BigInt> factorBase(sharedFactorBase->primes.begin(), sharedFactorBase->primes.end());
+    const std::vector<uint8_t> primeLogs = computePrimeLogs(factorBase);
+    const long long sieveRange = 15000;
+
+    // Full relations only, from as many families as it takes
+    std::vector<Relation<BigInt>> relations;
+    while(relations.size() <= factorBase.size() + relationExcess) {
+        PolyGenerator generator(number, selectBasePrimes(number, factorBase, sieveRange), sharedFactorBase);
+        PolynomialSolutions solutions;
+        while(generator.hasNext() && relations.size() <= factorBase.size() + relationExcess) {
+            const Polynomial polynomial = generator.next();
+            generator.findSolutions(solutions, polynomial);
+            for(auto &relation : sievePolynomial(polynomial, solutions, factorBase, primeLogs, sieveRange, 0, 0)) {
+                relations.emplace_back(std::move(relation));
+            }
+        }
+    }
+    relations = filterRelations(relations, number, factorBase.size());
+
+    std::vector<std::vector<int>> exponents;
+    std::vector<std::pair<BigInt, BigInt>> equivPairs;
+    for(const auto &relation : relations) {
+        exponents.emplace_back(factorBase.size());
+        for(const int index : relation.factors) {
+            exponents.back()[index]++;
+        }
+        equivPairs.emplace_back(relation.x, relation.y);
+    }
+    const auto dependencies = computeNullSpace(exponents);
+    ASSERT_GE(dependencies.size(), 16);
+
+    // The dependencies are evaluated on several threads, any of them may find the factor
+    const auto factor = findSquareFactor(dependencies, exponents, factorBase, equivPairs, number, 4);
+    ASSERT_TRUE(factor.has_value());
+    ASSERT_TRUE(*factor == p || *factor == q);
+
+    ASSERT_FALSE(findSquareFactor<BigInt>({}, exponents, factorBase, equivPairs, number, 4).has_value());
+}
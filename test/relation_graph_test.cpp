@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "relation_graph.h"
+#include "fixed_int.h"
+#include "utils.h"
+
+const BigInt p("15755393"), q("265042838657");
+const BigInt number = p * q;
+const std::vector<BigInt> factorBase = {2, 3, 5, 7, 11, 13};
+
+/**
+ * Builds a relation x^2 = smooth * largePrimes (mod number), with x from square roots modulo
+ * both prime factors. Tries products of factor base primes until one makes y a square.
+ */
+Relation<BigInt> makeRelation(const std::array<long long, 2> largePrimes) {
+    for(int mask = 1;; ++mask) {
+        Relation<BigInt> relation;
+        relation.largePrimes = largePrimes;
+        relation.y = BigInt(largePrimes[0]) * BigInt(largePrimes[1]);
+        for(int i = 0; i < factorBase.size(); ++i) {
+            if((mask >> i) & 1) {
+                relation.y *= factorBase[i];
+                relation.factors.push_back(i);
+            }
+        }
+
+        if(!isQuadraticResidue(relation.y % p, p) || !isQuadraticResidue(relation.y % q, q)) continue;
+
+        const BigInt rootP = tonelliShanks(relation.y % p, p);
+        const BigInt rootQ = tonelliShanks(relation.y % q, q);
+        relation.x = (rootP + p * ((rootQ - rootP) * BigInt::modInverse(p % q, q) % q)) % number;
+        return relation;
+    }
+}
+
+/**
+ * Checks that a combined relation is a full relation over the factor base
+ */
+void checkFullRelation(const Relation<BigInt> &relation) {
+    ASSERT_EQ(relation.largePrimes[1], 1);
+
+    BigInt smooth = 1;
+    for(const int index : relation.factors) {
+        smooth *= factorBase[index];
+    }
+    ASSERT_EQ(relation.x * relation.x % number, smooth % number);
+    ASSERT_EQ(relation.y, smooth % number);
+}
+
+TEST(RelationGraphTest, singleLargePrimeTest) {
+    LargePrimeGraph<BigInt> graph(number);
+
+    ASSERT_FALSE(graph.add(makeRelation({1, 1000003})).has_value());
+    ASSERT_FALSE(graph.add(makeRelation({1, 1000033})).has_value());
+    ASSERT_EQ(graph.size(), 2);
+
+    const auto combined = graph.add(makeRelation({1, 1000003}));
+    ASSERT_TRUE(combined.has_value());
+    checkFullRelation(*combined);
+    ASSERT_EQ(graph.size(), 2);
+}
+
+TEST(RelationGraphTest, cycleTest) {
+    LargePrimeGraph<BigInt> graph(number);
+
+    // 1 - 1000003 - 1000033 - 1000037 - 1000039 - 1000003 closes a cycle of length four
+    ASSERT_FALSE(graph.add(makeRelation({1, 1000003})).has_value());
+    ASSERT_FALSE(graph.add(makeRelation({1000003, 1000033})).has_value());
+    ASSERT_FALSE(graph.add(makeRelation({1000033, 1000037})).has_value());
+    ASSERT_FALSE(graph.add(makeRelation({1000037, 1000039})).has_value());
+    auto combined = graph.add(makeRelation({1000003, 1000039}));
+    ASSERT_TRUE(combined.has_value());
+    checkFullRelation(*combined);
+
+    // Through the single large prime relation back to 1
+    combined = graph.add(makeRelation({1, 1000037}));
+    ASSERT_TRUE(combined.has_value());
+    checkFullRelation(*combined);
+
+    // A square of a large prime is a cycle on its own
+    combined = graph.add(makeRelation({1000081, 1000081}));
+    ASSERT_TRUE(combined.has_value());
+    checkFullRelation(*combined);
+}
+
+TEST(RelationGraphTest, fixedIntTest) {
+    LargePrimeGraph<FixedInt<4>> graph{FixedInt<4>(number)};
+
+    const auto convert = [](const Relation<BigInt> &relation) {
+        return Relation<FixedInt<4>>{FixedInt<4>(relation.x), FixedInt<4>(relation.y), relation.factors,
+                                     relation.largePrimes};
+    };
+    ASSERT_FALSE(graph.add(convert(makeRelation({1000003, 1000033}))).has_value());
+    const auto combined = graph.add(convert(makeRelation({1000003, 1000033})));
+    ASSERT_TRUE(combined.has_value());
+
+    Relation<BigInt> relation{static_cast<BigInt>(combined->x), static_cast<BigInt>(combined->y),
+                              combined->factors, combined->largePrimes};
+    checkFullRelation(relation);
+}